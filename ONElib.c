@@ -40,7 +40,15 @@
 #include <unistd.h>
 #include <sys/uio.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <math.h>
+#include <zlib.h>
+#ifdef __linux__
+#include <sys/sendfile.h>  // for appending thread files in oneFinalize()
+#endif
+#ifdef __GLIBC__
+#include <stdio_ext.h>     // for __fsetlocking() in fopenRead()
+#endif
 
 #define DEBUG
 #ifdef DEBUG
@@ -50,11 +58,22 @@
 #endif
 
 #include "ONElib.h"
+#include "dnapack.h"
+#include "inflater.h"
+
+#ifdef ONE_STATS  // collect the read counters in OneInfo->io
+static inline I64 nsNow (void)
+{ struct timespec ts ;
+  clock_gettime (CLOCK_MONOTONIC, &ts) ;
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec ;
+}
+#endif
 
 // set major and minor code versions
 
 #define MAJOR 2
-#define MINOR 1
+#define MINOR 2           // highest minor version read
+#define MINOR_UNPACKED 1  // written unless an INT_LIST is bit-packed, so older code can read it
 
 //  utilities with implementation at the end of the file
 
@@ -80,6 +99,7 @@ void      vcAddHistogram(OneCodec *vc, OneCodec *vh);
 void      vcCreateCodec(OneCodec *vc, int partial);
 void      vcDestroy(OneCodec *vc);
 int       vcMaxSerialSize();
+bool      vcHasCodec(OneCodec *vc);
 int       vcSerialize(OneCodec *vc, void *out);
 OneCodec *vcDeserialize(void *in);
 I64       vcEncode(OneCodec *vc, I64 ilen, char *ibytes, char *obytes);
@@ -89,6 +109,7 @@ I64       vcDecode(OneCodec *vc, I64 ilen, char *ibytes, char *obytes);
 
 static inline int ltfWrite (I64 x, FILE *f) ;
 static inline I64 ltfRead (FILE *f) ;
+static inline int intGet (unsigned char *u, I64 *pval) ;
 
 // error handling
 
@@ -120,6 +141,9 @@ static OneInfo *infoDeepCopy (OneInfo *vi0)
   if (vi0->nField) vi->fieldType = dup (vi->nField, vi0->fieldType, OneType) ;
   if (vi0->listCodec && vi->listCodec != DNAcodec) vi->listCodec = vcCreate() ;
   if (vi0->index) vi->index = dup (vi->indexSize, vi0->index, I64) ;
+  vi->zone = 0 ; vi->zoneSize = 0 ; vi->zoneBlock = 0 ; // the zone map belongs to the file
+  memset (&vi->io, 0, sizeof(OneIOStat)) ;
+  vi->isSkipList = false ;
   if (vi0->stats)
     { int n = 1 ; OneStat *s ; for (s = vi->stats ; s->type ; ++s) ++n ;
       vi->stats = dup (n, vi0->stats, OneStat) ;
@@ -132,6 +156,7 @@ static void infoDestroy (OneInfo *vi)
   if (vi->listCodec) vcDestroy (vi->listCodec) ;
   if (vi->fieldType) free (vi->fieldType) ;
   if (vi->index) free (vi->index) ;
+  if (vi->zone) free (vi->zone) ;
   if (vi->stats) free (vi->stats) ;
   free (vi);
 }
@@ -187,7 +212,8 @@ static void schemaAddInfoFromArray (OneSchema *vs, int n, OneType *a, char t, ch
 	vi->listField = i ;
 	if (a[i] == oneDNA)
 	  { vi->listCodec = DNAcodec ; vi->isUseListCodec = true ; }
-	else if (t != '/') // make a listCodec for any list type except for commments
+	else if (t != '/' && t != '*') // make a listCodec for any list type except for commments
+				       // and zone maps, which are written after the codecs
 	  vi->listCodec = vcCreate () ; 
       }
 
@@ -198,6 +224,7 @@ static void schemaAddInfoFromArray (OneSchema *vs, int n, OneType *a, char t, ch
   else if (t == '&') vi->binaryTypePack = (53 << 1) | (char) 0x80 ; // byte index
   else if (t == '/') vi->binaryTypePack = (54 << 1) | (char) 0x80 ; // comment - binary only
   else if (t == '.') vi->binaryTypePack = (55 << 1) | (char) 0x80 ; // blank line
+  else if (t == '*') vi->binaryTypePack = (56 << 1) | (char) 0x80 ; // zone map
   // don't need for #, +, @, % because these lines are always written in ASCII
 }
 
@@ -276,14 +303,54 @@ static OneSchema *schemaLoadRecord (OneSchema *vs, OneFile *vf)
   return vs ;
 }
 
-static void oneFileDestroy (OneFile *vf) ; // need a forward declaration here
+static void oneFileDestroy (OneFile *vf) ; // need forward declarations here
+static OneFile *oneFileCreate (OneSchema **vsp, const char *type) ;
+static void initialiseStats (OneFile *vf) ;
 
-OneSchema *oneSchemaCreateFromFile (const char *filename)
+  // NB if you change the header spec and add a record with more than 4 fields,
+  //    change the assignment of ->nFieldMax in the 'P' section of schemaLoadRecord() above
+
+static char *headerSchemaText =
+  "D 1 3 6 STRING 3 INT 3 INT         line 1: primary type, major, minor version\n"
+  "D 2 1 6 STRING                     optional subtype: subtype\n"
+  "D # 2 4 CHAR 3 INT                 count: linetype, count\n"
+  "D @ 2 4 CHAR 3 INT                 max: linetype, list max\n"
+  "D + 2 4 CHAR 3 INT                 total: linetype, list total\n"
+  "D % 4 4 CHAR 4 CHAR 4 CHAR 3 INT  group maxes: group, #/+, linetype, value\n"
+  "D ! 1 11 STRING_LIST               provenance: program, version, command, date\n"
+  "D < 2 6 STRING 3 INT               reference: filename, object count\n"
+  "D > 1 6 STRING                     deferred: filename\n"
+  "D ~ 3 4 CHAR 4 CHAR 11 STRING_LIST embedded schema linetype definition\n"
+  "D . 0                              blank line, anywhere in file\n"
+  "D $ 1 3 INT                        binary file - goto footer: isBigEndian\n"
+  "D ^ 0                              binary file: end of footer designation\n"
+  "D - 1 3 INT                        binary file: offset of start of footer\n"
+  "D & 2 4 CHAR 8 INT_LIST            binary file: li->index\n"
+  "D ; 2 4 CHAR 6 STRING              binary file: list codec\n"
+  "D / 1 6 STRING                     binary file: comment\n"
+  "D * 3 4 CHAR 3 INT 8 INT_LIST      binary file: zone map: linetype, block size, min,max list\n" ;
+
+static char *defSchemaText =
+  "P 3 def                      this is the primary file type for schemas\n"
+  "O P 1 6 STRING               primary type name\n"
+  "D S 1 6 STRING               secondary type name\n"
+  "D O 2 4 CHAR 11 STRING_LIST  define linetype for object type (indexed)\n"
+  "D G 1 4 CHAR                 define linetype for grouping another object\n"
+  "D D 2 4 CHAR 11 STRING_LIST  define linetype for other records\n"
+  "\n" ; // terminator
+
+static FILE *textStream (const char *text) // read text in memory as a FILE - no temp files
 {
-  FILE *fs = fopen (filename, "r") ;
-  if (!fs) return 0 ;
-  fclose(fs);
+  FILE *f = fmemopen ((void*) text, strlen (text), "r") ;
+  if (!f) die ("ONE schema failure: cannot open memory stream errno %d", errno) ;
+  return f ;
+}
+
+  // Make the schema from either a file or text already in memory - text must be bare,
+  //   i.e. start with the P line, which is what oneSchemaCreateFromText() gives us
 
+static OneSchema *schemaCreate (const char *filename, const char *text)
+{
   OneSchema *vs = new0 (1, OneSchema) ;
 
   OneFile *vf = new0 (1, OneFile) ;      // shell object to support bootstrap
@@ -301,71 +368,30 @@ OneSchema *oneSchemaCreateFromFile (const char *filename)
     vf->field = new (2, OneField) ;
   }
 
-  // first load the universal header and footer (non-alphabetic) line types 
-  // do this by writing their schema into a temporary file and parsing it into the base schema
-  { errno = 0 ;
-// #define VALGRIND_MACOS
-    char template[4096] ;
-    const char *tmpdir = getenv("TMPDIR") ;
-    if (!tmpdir) tmpdir = "/tmp" ;
-#ifdef VALGRIND_MACOS // MacOS valgrind is missing functions to make temp files it seems
-    snprintf (template, sizeof(template), "%s/OneSchema-%d", getpid()) ;
-    vf->f = fopen (template, "w+") ;
-    if (errno) die ("failed to open temporary file %s errno %d\n", template, errno) ;
-#else
-    snprintf (template, sizeof(template), "%s/OneSchema-XXXXXX", tmpdir) ;
-    int fd = mkstemp (template) ;
-    if (errno) die ("failed to open temporary file %s errno %d\n", template, errno) ;
-    vf->f = fdopen (fd, "w+") ;
-    if (errno) die ("failed to assign temporary file to stream: errno %d\n", errno) ;
-#endif
-    unlink (template) ;                  // this ensures that the file is removed on closure
-    if (errno) die ("failed to remove temporary file %s errno %d\n", template, errno) ;
-  }
-
-  // NB if you change the header spec and add a record with more than 4 fields,
-  //    change the assignment of ->nFieldMax in the 'P' section of schemaLoadRecord() above
-  
-  fprintf (vf->f, "D 1 3 6 STRING 3 INT 3 INT         line 1: primary type, major, minor version\n") ;
-  fprintf (vf->f, "D 2 1 6 STRING                     optional subtype: subtype\n") ;
-  fprintf (vf->f, "D # 2 4 CHAR 3 INT                 count: linetype, count\n") ;
-  fprintf (vf->f, "D @ 2 4 CHAR 3 INT                 max: linetype, list max\n") ;
-  fprintf (vf->f, "D + 2 4 CHAR 3 INT                 total: linetype, list total\n") ;
-  fprintf (vf->f, "D %% 4 4 CHAR 4 CHAR 4 CHAR 3 INT  group maxes: group, #/+, linetype, value\n") ;
-  fprintf (vf->f, "D ! 1 11 STRING_LIST               provenance: program, version, command, date\n") ;
-  fprintf (vf->f, "D < 2 6 STRING 3 INT               reference: filename, object count\n") ;
-  fprintf (vf->f, "D > 1 6 STRING                     deferred: filename\n") ;
-  fprintf (vf->f, "D ~ 3 4 CHAR 4 CHAR 11 STRING_LIST embedded schema linetype definition\n") ;
-  fprintf (vf->f, "D . 0                              blank line, anywhere in file\n") ;
-  fprintf (vf->f, "D $ 1 3 INT                        binary file - goto footer: isBigEndian\n") ;
-  fprintf (vf->f, "D ^ 0                              binary file: end of footer designation\n") ;
-  fprintf (vf->f, "D - 1 3 INT                        binary file: offset of start of footer\n") ;
-  fprintf (vf->f, "D & 2 4 CHAR 8 INT_LIST            binary file: li->index\n") ;
-  fprintf (vf->f, "D ; 2 4 CHAR 6 STRING              binary file: list codec\n") ;
-  fprintf (vf->f, "D / 1 6 STRING                     binary file: comment\n") ;
-  if (fseek (vf->f, 0, SEEK_SET)) die ("ONE schema failure: cannot rewind tmp file") ;
+  // first load the universal header and footer (non-alphabetic) line types
+  vf->f = textStream (headerSchemaText) ;
   while (oneReadLine (vf))
     schemaLoadRecord (vs, vf) ;
+  fclose (vf->f) ;
 
-  // next reuse the temp file to load the schema for reading schemas
-  if (fseek (vf->f, 0, SEEK_SET)) die ("ONE schema failure: cannot rewind tmp file") ;
-  fprintf (vf->f, "P 3 def                      this is the primary file type for schemas\n") ;
-  fprintf (vf->f, "O P 1 6 STRING               primary type name\n") ;
-  fprintf (vf->f, "D S 1 6 STRING               secondary type name\n") ;
-  fprintf (vf->f, "D O 2 4 CHAR 11 STRING_LIST  define linetype for object type (indexed)\n") ;
-  fprintf (vf->f, "D G 1 4 CHAR                 define linetype for grouping another object\n") ;
-  fprintf (vf->f, "D D 2 4 CHAR 11 STRING_LIST  define linetype for other records\n") ;
-  fprintf (vf->f, "\n") ; // terminator
-  if (fseek (vf->f, 0, SEEK_SET)) die ("ONE schema failure: cannot rewind tmp file") ;
+  // next load the schema for reading schemas
+  vf->f = textStream (defSchemaText) ;
   OneSchema *vs0 = vs ;  // need this because loadInfo() updates vs on reading P lines
   vf->line = 0 ;
   while (oneReadLine (vf))
     vs = schemaLoadRecord (vs, vf) ;
   OneSchema *vsDef = vs ; // will need this to destroy it once the true schema is read
-  oneFileDestroy (vf) ;   // this will also effectively remove the temp file on closing
+  oneFileDestroy (vf) ;   // this also closes the stream
 
   // finally read the schema itself
-  if (!(vf = oneFileOpenRead (filename, vs0, "def", 1)))
+  if (text)
+    { vs = vs0 ;
+      vf = oneFileCreate (&vs, "def") ; // as oneFileOpenRead() does for a bare file
+      vf->f = textStream (text) ;
+      vf->fileName = strdup ("schema text") ;
+      initialiseStats (vf) ;
+    }
+  else if (!(vf = oneFileOpenRead (filename, vs0, "def", 1)))
     return 0 ;
   vs = vs0 ; // set back to vs0, so next filetype spec will replace vsDef
   vs->nxt = 0 ;
@@ -377,6 +403,15 @@ OneSchema *oneSchemaCreateFromFile (const char *filename)
   return vs0 ;
 }
 
+OneSchema *oneSchemaCreateFromFile (const char *filename)
+{
+  FILE *fs = fopen (filename, "r") ;
+  if (!fs) return 0 ;
+  fclose(fs);
+
+  return schemaCreate (filename, 0) ;
+}
+
 static char *schemaFixNewlines (const char *text)
 { // replace literal "\n" by '\n' chars in text
   char *newText = strdup (text) ;
@@ -390,21 +425,86 @@ static char *schemaFixNewlines (const char *text)
   return newText ;
 }
   
-OneSchema *oneSchemaCreateFromText (const char *text) // write to temp file and call CreateFromFile()
+static OneSchema *schemaDeepCopy (OneSchema *vs0)
 {
-  // Claude points out that the getpid() solution below is not threadsafe.  So it proposed the code below.
-  // static char template[64] ;
-  // sprintf (template, "/tmp/OneTextSchema-%d.schema", getpid()) ;
-  
-  char template[4096];
-  const char *tmpdir = getenv("TMPDIR");
-  if (!tmpdir) tmpdir = "/tmp";
-  snprintf(template, sizeof(template), "%s/OneTextSchema-XXXXXX", tmpdir);
-  errno = 0 ;
-  int fd = mkstemp(template) ;
-  if (fd == -1) die ("failed to make temporary file %s for writing schema to - errno %d", template, errno) ;
-  FILE *f = fdopen(fd, "w") ;
-  if (!f) die ("failed to fdopen temporary file %s for writing schema to - errno %d", template, errno) ;
+  OneSchema *vs, *vsHead = 0, **vsp = &vsHead ;
+  int        i ;
+
+  for ( ; vs0 ; vs0 = vs0->nxt)
+    { vs = new (1, OneSchema) ;
+      *vs = *vs0 ;
+      if (vs0->primary) vs->primary = strdup (vs0->primary) ;
+      if (vs0->nSecondary)
+	{ vs->secondary = new (vs0->nSecondary, char*) ;
+	  for (i = 0 ; i < vs0->nSecondary ; ++i) vs->secondary[i] = strdup (vs0->secondary[i]) ;
+	}
+      vs->currentObject = 0 ;
+      for (i = 0 ; i < 128 ; ++i)
+	if (vs0->info[i])
+	  { vs->info[i] = infoDeepCopy (vs0->info[i]) ;
+	    if (vs0->currentObject == vs0->info[i]) vs->currentObject = vs->info[i] ;
+	  }
+      for (i = 0 ; i < vs0->nDefn ; ++i)
+	if (vs0->defnComment[i]) vs->defnComment[i] = strdup (vs0->defnComment[i]) ;
+      vs->nxt = 0 ;
+      *vsp = vs ;
+      vsp = &vs->nxt ;
+    }
+
+  return vsHead ;
+}
+
+  // Process-wide cache of schemas made from text, so that repeated opens of the same
+  //   type (every oneFileOpenRead() makes one from its header) only parse once.
+  //   Keyed by a hash of the text, with the text kept to check.  Callers get a deep
+  //   copy, which they own and destroy as before.  Hits move to the front, and beyond
+  //   SCHEMA_CACHE_MAX entries the least recently used is dropped.  oneSchemaCacheClear()
+  //   frees the whole cache.
+
+#define SCHEMA_CACHE_MAX 64
+
+typedef struct SchemaCacheStruct {
+  uint64_t   hash ;
+  char      *text ;
+  OneSchema *vs ;
+  struct SchemaCacheStruct *nxt ;
+} SchemaCache ;
+
+static SchemaCache    *schemaCache = 0 ;
+static int             schemaCacheSize = 0 ;
+static pthread_mutex_t schemaCacheLock = PTHREAD_MUTEX_INITIALIZER ;
+
+static void schemaCacheFree (SchemaCache *sc)
+{
+  free (sc->text) ;
+  oneSchemaDestroy (sc->vs) ;
+  free (sc) ;
+}
+
+static uint64_t textHash (const char *s) // 64-bit FNV-1a
+{
+  uint64_t h = 0xcbf29ce484222325ULL ;
+  while (*s) { h ^= (U8) *s++ ; h *= 0x100000001b3ULL ; }
+  return h ;
+}
+
+OneSchema *oneSchemaCreateFromText (const char *text) // parsed in memory, with a cache
+{
+  uint64_t     hash = textHash (text) ;
+  SchemaCache *sc ;
+  OneSchema   *vs = 0 ;
+
+  SchemaCache **scp ;
+  pthread_mutex_lock (&schemaCacheLock) ;
+  for (scp = &schemaCache ; (sc = *scp) ; scp = &sc->nxt)
+    if (sc->hash == hash && !strcmp (sc->text, text))
+      { vs = schemaDeepCopy (sc->vs) ;
+	*scp = sc->nxt ; sc->nxt = schemaCache ; schemaCache = sc ; // move to front
+	break ;
+      }
+  pthread_mutex_unlock (&schemaCacheLock) ;
+  if (vs) return vs ;
+
   char *fixedText = schemaFixNewlines (text) ;
   char *s = fixedText ;
   while (*s && *s != 'P')
@@ -412,22 +512,48 @@ OneSchema *oneSchemaCreateFromText (const char *text) // write to temp file and
       if (*s == '\n') ++s ;
     }
   if (!*s) die ("no P line in schema text") ;
-  fprintf (f, "%s\n", s) ;
+  char *bareText = new (strlen(s)+2, char) ;
+  strcpy (bareText, s) ;
+  strcat (bareText, "\n") ;
   free (fixedText) ;
-  fclose (f) ;
-  if (errno) die ("failed to write temporary file %s errno %d\n", template, errno) ;
-
-  OneSchema *vs = oneSchemaCreateFromFile (template) ;
 
-  errno = 0 ;
-  unlink (template) ;  // delete temporary file - not ideal: will remain if schemaCreate crashes
-  if (errno) die ("failed to remove temporary file %s errno %d\n", template, errno) ;
+  vs = schemaCreate (0, bareText) ;
+  free (bareText) ;
+  if (!vs) return 0 ;
+
+  sc = new (1, SchemaCache) ;
+  sc->hash = hash ;
+  sc->text = strdup (text) ;
+  sc->vs   = schemaDeepCopy (vs) ;
+  pthread_mutex_lock (&schemaCacheLock) ;
+  sc->nxt = schemaCache ;
+  schemaCache = sc ;
+  if (++schemaCacheSize > SCHEMA_CACHE_MAX) // drop the last, least recently used
+    { scp = &schemaCache ;
+      while ((*scp)->nxt) scp = &(*scp)->nxt ;
+      schemaCacheFree (*scp) ;
+      *scp = 0 ;
+      --schemaCacheSize ;
+    }
+  pthread_mutex_unlock (&schemaCacheLock) ;
 
   return vs ;
 }
 
+void oneSchemaCacheClear (void)
+{
+  pthread_mutex_lock (&schemaCacheLock) ;
+  while (schemaCache)
+    { SchemaCache *sc = schemaCache ;
+      schemaCache = sc->nxt ;
+      schemaCacheFree (sc) ;
+    }
+  schemaCacheSize = 0 ;
+  pthread_mutex_unlock (&schemaCacheLock) ;
+}
+
 static OneSchema *oneSchemaCreateDynamic (char *fileType, char *subType)
-{ // this is clean, but it seems a bit wasteful to create a temp file
+{ // cheap now that text schemas are parsed in memory and cached
   char *text ;
   assert (fileType && strlen(fileType) > 0) ;
   assert (!subType || strlen(subType) > 0) ;
@@ -674,6 +800,126 @@ static void provRefDefCleanup (OneFile *vf)
     }
 }
 
+/******************* read-ahead ********************/
+
+  // A helper thread keeps a window of the file ahead of the read position in memory, so
+  //   that I/O overlaps with decoding and the caller's processing.  For a mapped file it
+  //   touches each page, else it pread()s into a scratch buffer to fill the page cache.
+  //   Either way the helper blocks on the I/O rather than the reader.
+
+typedef struct {
+  OneFile        *vf ;
+  int             fd ;
+  I64             window, step ;
+  off_t           size ;
+  off_t           pos ;         // reader position, as last published - under mutex
+  bool            isStop ;      // under mutex
+  off_t           lastPos ;     // reader thread only
+  char           *buf ;         // pread() scratch - allocated by the reader, as myalloc() is not thread safe
+  pthread_mutex_t mutex ;
+  pthread_cond_t  cond ;
+  pthread_t       thread ;
+} OnePrefetch ;
+
+#define PREFETCH_CHUNK (1 << 20)
+
+static off_t readPos (OneFile *vf)
+{
+  return vf->mapPos ? vf->mapPos - vf->mapBase : ftello (vf->f) ;
+}
+
+static void prefetchNote (OneFile *vf) // called by the reader; wakes the helper every step bytes
+{
+  OnePrefetch *pf = (OnePrefetch*) vf->prefetch ;
+  off_t        pos = readPos (vf) ;
+
+  if (pos >= pf->lastPos && pos < pf->lastPos + pf->step) return ;
+  pthread_mutex_lock (&pf->mutex) ;
+  pf->pos = pos ;
+  pthread_cond_signal (&pf->cond) ;
+  pthread_mutex_unlock (&pf->mutex) ;
+  pf->lastPos = pos ;
+}
+
+static void *prefetchThread (void *arg)
+{
+  OnePrefetch  *pf = (OnePrefetch*) arg ;
+  OneFile      *vf = pf->vf ;
+  I64           chunk = PREFETCH_CHUNK ;
+  long          page = sysconf (_SC_PAGESIZE) ;
+  off_t         ahead = 0, i ;
+  volatile char sink ;
+
+  pthread_mutex_lock (&pf->mutex) ;
+  while (!pf->isStop && ahead < pf->size)
+    { off_t pos = pf->pos ;
+      if (ahead < pos || ahead > pos + 2*pf->window) // moved past us, or jumped back
+	ahead = pos ;
+      if (ahead >= pos + pf->window) // far enough ahead - wait for the reader
+	{ pthread_cond_wait (&pf->cond, &pf->mutex) ;
+	  continue ;
+	}
+      pthread_mutex_unlock (&pf->mutex) ;
+      I64 n = (pf->size - ahead < chunk) ? pf->size - ahead : chunk ;
+      if (vf->mapBase)
+	for (i = 0 ; i < n ; i += page) sink = vf->mapBase[ahead+i] ;
+      else if (pread (pf->fd, pf->buf, n, ahead) <= 0)
+	n = pf->size - ahead ; // give up
+      ahead += n ;
+      pthread_mutex_lock (&pf->mutex) ;
+    }
+  pthread_mutex_unlock (&pf->mutex) ;
+  (void) sink ;
+  return 0 ;
+}
+
+bool oneFilePrefetch (OneFile *vf, I64 window)
+{
+  OnePrefetch *pf = (OnePrefetch*) vf->prefetch ;
+  struct stat  st ;
+  int          fd ;
+
+  if (pf) // stop any existing helper
+    { pthread_mutex_lock (&pf->mutex) ;
+      pf->isStop = true ;
+      pthread_cond_signal (&pf->cond) ;
+      pthread_mutex_unlock (&pf->mutex) ;
+      pthread_join (pf->thread, 0) ;
+      pthread_mutex_destroy (&pf->mutex) ;
+      pthread_cond_destroy (&pf->cond) ;
+      if (pf->buf) free (pf->buf) ;
+      free (pf) ;
+      vf->prefetch = 0 ;
+    }
+  if (window <= 0) return true ;
+
+  // file offsets must be real ones: a gzip stream is a cookie FILE with no descriptor,
+  //   and its ftello() gives the uncompressed position
+  if (vf->isWrite || vf->share < 0 || !vf->f || (fd = fileno (vf->f)) < 0
+      || fstat (fd, &st) != 0 || !S_ISREG(st.st_mode) || lseek (fd, 0, SEEK_CUR) < 0)
+    return false ;
+
+  pf = new0 (1, OnePrefetch) ;
+  pf->vf      = vf ;
+  pf->fd      = fd ;
+  pf->window  = window ;
+  pf->step    = (window >> 2) ? window >> 2 : 1 ;
+  pf->size    = st.st_size ;
+  pf->pos     = pf->lastPos = readPos (vf) ;
+  if (!vf->mapBase) pf->buf = new (PREFETCH_CHUNK, char) ;
+  pthread_mutex_init (&pf->mutex, 0) ;
+  pthread_cond_init (&pf->cond, 0) ;
+  if (pthread_create (&pf->thread, 0, prefetchThread, pf) != 0)
+    { pthread_mutex_destroy (&pf->mutex) ;
+      pthread_cond_destroy (&pf->cond) ;
+      if (pf->buf) free (pf->buf) ;
+      free (pf) ;
+      return false ;
+    }
+  vf->prefetch = pf ;
+  return true ;
+}
+
 static void oneFileCleanupSlaves (OneFile *vf)
 { int      i, j;
   OneInfo *li, *lx;
@@ -695,6 +941,7 @@ static void oneFileCleanupSlaves (OneFile *vf)
   for (j = 1; j < vf->share; j++)
     { provRefDefCleanup (&vf[j]) ;
       if (vf[j].codecBuf   != NULL) free (vf[j].codecBuf);
+      if (vf[j].packBuf    != NULL) free (vf[j].packBuf);
       if (vf[j].f          != NULL) fclose (vf[j].f);
     }
 }
@@ -702,11 +949,14 @@ static void oneFileCleanupSlaves (OneFile *vf)
 static void oneFileDestroy (OneFile *vf)
 { int      i, j;
 
+  if (vf->prefetch) oneFilePrefetch (vf, 0) ; // must stop before unmapping or closing
   if (vf->share)
     oneFileCleanupSlaves (vf) ;
 
   provRefDefCleanup (vf) ;
   if (vf->codecBuf != NULL) free (vf->codecBuf);
+  if (vf->packBuf != NULL) free (vf->packBuf);
+  if (vf->mapBase != NULL) munmap (vf->mapBase, vf->mapEnd - vf->mapBase) ;
   if (vf->f != NULL && vf->f != stdout) fclose (vf->f);
 
   for (i = 0; i < 128 ; i++)
@@ -754,8 +1004,12 @@ static void parseDie (OneFile *vf, char *format, ...)
   exit (1);
 }
 
+  // Each thread and cursor has its own FILE from fopenRead(), and only its own thread reads
+  //   it, so we can skip the stdio lock, which glibc takes on every call once a process has
+  //   threads.  That made ascii input with several threads cost twice the CPU of one.
+
 static inline char vfGetc(OneFile *vf)
-{ char c = getc(vf->f);
+{ char c = getc_unlocked(vf->f);
   if (vf->linePos < 127)
     vf->lineBuf[vf->linePos++] = c;
   return c;
@@ -847,7 +1101,7 @@ static inline void readFlush (OneFile *vf) // reads to the end of the line and s
   OneInfo   *li = vf->info['/'] ;
 
   // check the first character - if it is newline then done
-  x = getc (vf->f) ; 
+  x = getc_unlocked (vf->f) ; 
   if (x == '\n')
     return ;
   else if (x != ' ')
@@ -859,7 +1113,7 @@ static inline void readFlush (OneFile *vf) // reads to the end of the line and s
       li->buffer = new (li->bufSize, char) ;
     }
   
-  while ((x = getc (vf->f)) && x != '\n')
+  while ((x = getc_unlocked (vf->f)) && x != '\n')
     if (x == EOF)
       parseDie (vf, "premature end of file");
     else
@@ -906,7 +1160,103 @@ static inline void updateTotalAndBuffer (OneFile *vf, char t, I64 size, I64 nStr
  *
  **********************************************************************************/
 
-static char *compactIntList (OneFile *vf, OneInfo *li, I64 len, char *buf, int *usedBytes)
+  // An alternative encoding packs zigzag-coded differences into frames of INT_FRAME values,
+  //   each frame a byte giving the bit width w followed by the values in w bits each,
+  //   little-endian, so a full frame takes 4w bytes.  This is signalled by INT_LIST_PACKED
+  //   in the byte that otherwise gives the compacted width, followed by the packed size.
+  //   oneWriteLine() uses it when it is smaller than the (possibly Huffman coded) bytes.
+  //   Only files that contain packed lists get minor version MINOR in their header, patched
+  //   in when the file is closed, so packing is only done if the output is seekable.
+
+#define INT_LIST_PACKED 0x80
+#define INT_FRAME       32
+
+static inline uint64_t zigzag (I64 x) { return ((uint64_t) x << 1) ^ (uint64_t) (x >> 63) ; }
+static inline I64 unzigzag (uint64_t z) { return (I64) (z >> 1) ^ -(I64) (z & 1) ; }
+
+static inline uint64_t load64le (U8 *p)
+{ uint64_t w ;
+  memcpy (&w, p, 8) ;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  w = __builtin_bswap64 (w) ;
+#endif
+  return w ;
+}
+
+static I64 packIntList (OneFile *vf, I64 *diff, I64 n, uint64_t *allBits)
+{ // packs into vf->packBuf, returns size, sets *allBits to the OR of all the zigzag values
+  I64 i, j, m ;
+  U8 *out ;
+  
+  if (n*9 + 16 > vf->packBufSize) // worst case is 8 bytes per value plus a byte per frame
+    { if (vf->packBuf) free (vf->packBuf) ;
+      vf->packBufSize = n*9 + 16 + 0x10000 ;
+      vf->packBuf = new (vf->packBufSize, U8) ;
+    }
+  out = vf->packBuf ;
+  *allBits = 0 ;
+  
+  for (i = 0 ; i < n ; i += INT_FRAME, diff += INT_FRAME)
+    { uint64_t z, acc = 0, all = 0 ;
+      int w, k, nAcc = 0 ;
+      m = (n - i < INT_FRAME) ? n - i : INT_FRAME ;
+      for (j = 0 ; j < m ; ++j) all |= zigzag (diff[j]) ;
+      *allBits |= all ;
+      w = all ? 64 - __builtin_clzll (all) : 0 ;
+      *out++ = w ;
+      if (!w) continue ;
+      for (j = 0 ; j < m ; ++j)
+	{ z = zigzag (diff[j]) ;
+	  acc |= z << nAcc ;
+	  nAcc += w ;
+	  if (nAcc >= 64)
+	    { for (k = 0 ; k < 8 ; ++k, acc >>= 8) *out++ = acc ;
+	      nAcc -= 64 ;
+	      acc = nAcc ? z >> (w - nAcc) : 0 ;
+	    }
+	}
+      for ( ; nAcc > 0 ; nAcc -= 8, acc >>= 8) *out++ = acc ;
+    }
+
+  return out - vf->packBuf ;
+}
+
+  // Unpack n values into x[0..n), with x[-1] the value before them.  NB reads up to 7 bytes
+  //   beyond the end of the packed data, so the caller must make sure they are there.
+
+static void unpackIntList (U8 *in, I64 *x, I64 n)
+{ I64 i, j, m, v = x[-1] ;
+
+  for (i = 0 ; i < n ; i += INT_FRAME, x += INT_FRAME)
+    { int w = *in++ ;
+      m = (n - i < INT_FRAME) ? n - i : INT_FRAME ;
+      if (w == 0)
+	for (j = 0 ; j < m ; ++j) x[j] = v ;
+      else if (w <= 57) // each value is within one unaligned 64-bit word
+	{ uint64_t mask = ((uint64_t)1 << w) - 1 ;
+	  for (j = 0 ; j < m ; ++j)  // first unpack - independent so the compiler can vectorise
+	    { uint64_t bit = j*w ;
+	      x[j] = unzigzag ((load64le (in + (bit >> 3)) >> (bit & 7)) & mask) ;
+	    }
+	  for (j = 0 ; j < m ; ++j) x[j] = (v += x[j]) ; // then undo the differencing
+	}
+      else if (w <= 64)
+	{ uint64_t mask = (w == 64) ? ~(uint64_t)0 : ((uint64_t)1 << w) - 1 ;
+	  for (j = 0 ; j < m ; ++j)
+	    { uint64_t bit = j*w, s = bit & 7 ;
+	      uint64_t z = load64le (in + (bit >> 3)) >> s ;
+	      if (s + w > 64) z |= (uint64_t) in[(bit >> 3) + 8] << (64 - s) ;
+	      x[j] = (v += unzigzag (z & mask)) ;
+	    }
+	}
+      else
+	die ("ONE read error: bad packed int list frame width %d", w) ;
+      in += (m*w + 7) >> 3 ;
+    }
+}
+
+static char *compactIntList (OneFile *vf, OneInfo *li, I64 len, char *buf, int *usedBytes,
+			     I64 *packSize)
 { char *y;
   int   d, k;
   I64   z, i, mask, *ibuf;
@@ -926,13 +1276,21 @@ static char *compactIntList (OneFile *vf, OneInfo *li, I64 len, char *buf, int *
 
   for (i = len-1; i > 0; i--)  // convert to differences - often a big win, else harmless
     ibuf[i] -= ibuf[i-1];
-  
-  mask = 0;                    // find how many top bytes can be skipped
-  for (i = 1; i < len; i++)
-    if (ibuf[i] >= 0) 
-      mask |= ibuf[i];
-    else
-      mask |= -(ibuf[i]+1);
+
+  if (vf->isPackable)          // zigzag(x) >> 1 is x if x >= 0, else -(x+1), as needed for mask
+    { uint64_t allBits ;
+      *packSize = packIntList (vf, &ibuf[1], len-1, &allBits) ;
+      mask = allBits >> 1 ;
+    }
+  else
+    { *packSize = -1 ;
+      mask = 0;                // find how many top bytes can be skipped
+      for (i = 1; i < len; i++)
+	if (ibuf[i] >= 0) 
+	  mask |= ibuf[i];
+	else
+	  mask |= -(ibuf[i]+1);
+    }
 
   k = sizeof(I64) ;
   mask >>= 7;
@@ -968,6 +1326,9 @@ static void decompactIntList (OneFile *vf, I64 len, char *buf, int usedBytes)
 { int   d, z, k;
   char *s, *t;
 
+#ifdef ONE_STATS
+  vf->info[(int) vf->lineType]->io.nDecompact += 1 ;
+#endif
   z = sizeof(I64) - usedBytes ;
   
   if (z > 0)                          // decompacts in place
@@ -1042,6 +1403,36 @@ static inline void readCompressedFields (FILE *f, OneField *field, OneInfo *li)
       }
 }
 
+// equivalents reading from the memory mapped file at vf->mapPos
+
+static inline I64 ltfReadMap (OneFile *vf)
+{
+  I64 val ;
+  int n = intGet ((unsigned char*) vf->mapPos, &val) ;
+
+  if (!n) die ("ONE read error: bad integer encoding in mapped file") ;
+  vf->mapPos += n ;
+  return val ;
+}
+
+static inline void readCompressedFieldsMap (OneFile *vf, OneField *field, OneInfo *li)
+{
+  int i ;
+  
+  for (i = 0 ; i < li->nField ; ++i)
+    switch (li->fieldType[i])
+      {
+      case oneREAL:
+	memcpy (&field[i].r, vf->mapPos, 8) ; vf->mapPos += 8 ;
+	break ;
+      case oneCHAR:
+	field[i].c = *vf->mapPos++ ;
+	break ;
+      default: // includes INT and all the LISTs, which store their length in field as an INT
+	field[i].i = ltfReadMap (vf) ;
+      }
+}
+
 /***********************************************************************************
  *
  *  ONE_READ_LINE:
@@ -1081,20 +1472,221 @@ static void readStringList(OneFile *vf, char t, I64 len)
 
 bool addProvenance(OneFile *vf, OneProvenance *from, int n) ; // need forward declaration
 
+  // Read a bit-packed INT_LIST, from the map if there is one.  The first element is
+  //   already in li->buffer.  Copy into codecBuf if needed for the 8 bytes of overrun.
+
+static void readPackedIntList (OneFile *vf, OneInfo *li, I64 listLen)
+{
+  I64 size = vf->mapPos ? ltfReadMap (vf) : ltfRead (vf->f) ;
+  U8 *in ;
+
+#ifdef ONE_STATS
+  li->io.nUnpack += 1 ;
+#endif
+
+  if (vf->mapPos && vf->mapPos + size + 8 <= vf->mapEnd)
+    in = (U8*) vf->mapPos ;
+  else
+    { if (size + 8 > vf->codecBufSize)
+	{ if (vf->codecBuf) free (vf->codecBuf) ;
+	  vf->codecBufSize = size + 8 ;
+	  vf->codecBuf = new (vf->codecBufSize, char) ;
+	}
+      if (vf->mapPos)
+	{ if (vf->mapPos + size > vf->mapEnd)
+	    die ("ONE read error: list runs off end of mapped file %s", vf->fileName) ;
+	  memcpy (vf->codecBuf, vf->mapPos, size) ;
+	}
+      else if (fread (vf->codecBuf, size, 1, vf->f) != 1)
+	die ("ONE read error: failed to read packed list size %lld", size) ;
+      in = (U8*) vf->codecBuf ;
+    }
+  if (vf->mapPos) vf->mapPos += size ;
+
+  unpackIntList (in, &(((I64*)li->buffer)[1]), listLen-1) ;
+}
+
+  // Step over the list of a binary line without reading it, for oneSkipList().  We only
+  //   need the header values that give the size of the list in the file.
+
+static void skipList (OneFile *vf, OneInfo *li, I64 listLen, U8 x)
+{
+  I64 skip ;
+
+  if (li->fieldType[li->listField] == oneINT_LIST) // first element and width come first
+    { if (vf->mapPos)
+	{ ltfReadMap (vf) ;
+	  if (listLen == 1) return ;
+	  vf->intListBytes = (U8) *vf->mapPos++ ;
+	}
+      else
+	{ ltfRead (vf->f) ;
+	  if (listLen == 1) return ;
+	  vf->intListBytes = getc_unlocked (vf->f) ;
+	}
+      if (vf->intListBytes == INT_LIST_PACKED)
+	skip = vf->mapPos ? ltfReadMap (vf) : ltfRead (vf->f) ;
+      else
+	skip = (listLen-1) * vf->intListBytes ;
+    }
+  else
+    skip = listLen * li->listEltSize ;
+
+  if (x & 0x1) // compressed - size in bits is given explicitly
+    skip = ((vf->mapPos ? ltfReadMap (vf) : ltfRead (vf->f)) + 7) >> 3 ;
+
+  if (vf->mapPos)
+    { vf->mapPos += skip ;
+      if (vf->mapPos > vf->mapEnd)
+	die ("ONE read error: list runs off end of mapped file %s", vf->fileName) ;
+    }
+  else if (fseeko (vf->f, skip, SEEK_CUR) != 0)
+    die ("ONE read error: failed to skip list of %lld bytes", skip) ;
+}
+
+  // Comments have no '@' max in the footer of a binary file, so size their buffer as we go.
+
+static inline void commentBufFit (OneInfo *li, I64 listLen)
+{
+  if (listLen < li->bufSize) return ;
+  if (li->buffer) free (li->buffer) ;
+  li->bufSize = listLen + 1 ;
+  li->buffer = new (li->bufSize, char) ;
+}
+
+  // Binary line body read directly from the memory map.  Uncompressed lists that need no
+  //   transformation are left in place and pointed to by vf->mapList, compressed lists
+  //   by vf->mapCodec.  Otherwise it follows the stdio code in oneReadLine() below.
+
+static void readLineMap (OneFile *vf, OneInfo *li, U8 x, char t)
+{
+  if (li->nField > 0)
+    readCompressedFieldsMap (vf, vf->field, li) ;
+
+  if (li->listEltSize > 0)
+    { I64     listLen = oneLen(vf);
+      OneType type = li->fieldType[li->listField] ;
+
+      if (listLen > 0)
+	{ li->accum.total += listLen;
+	  if (listLen > li->accum.max)
+	    li->accum.max = listLen;
+
+	  if (li->isSkipList)
+	    { skipList (vf, li, listLen, x) ;
+	      goto doneLine ;
+	    }
+	  if (t == '/') commentBufFit (li, listLen) ;
+
+	  if (type == oneINT_LIST)
+	    { *(I64*)li->buffer = ltfReadMap (vf) ;
+	      if (listLen == 1) goto doneLine ;
+	      vf->intListBytes = (U8) *vf->mapPos++ ;
+	    }
+
+	  if (type == oneSTRING_LIST) // handled as ASCII, so via stdio
+	    { if (fseeko (vf->f, vf->mapPos - vf->mapBase, SEEK_SET) != 0)
+		die ("ONE read error: failed to seek to string list in mapped file") ;
+	      readStringList (vf, t, listLen);
+	      vf->mapPos = vf->mapBase + ftello (vf->f) ;
+	    }
+	  else if (type == oneINT_LIST && vf->intListBytes == INT_LIST_PACKED)
+	    readPackedIntList (vf, li, listLen) ;
+	  else if (x & 0x1) // list is compressed - leave it in the map for _oneList()
+	    { vf->nBits = ltfReadMap (vf) ;
+	      vf->mapCodec = vf->mapPos ;
+	      vf->mapPos += (vf->nBits+7) >> 3 ;
+	    }
+	  else if (type == oneINT_LIST)
+	    { I64 listSize  = (listLen-1) * vf->intListBytes ;
+	      memcpy (&(((I64*)li->buffer)[1]), vf->mapPos, listSize) ;
+	      vf->mapPos += listSize ;
+	      decompactIntList (vf, listLen, li->buffer, vf->intListBytes);
+	    }
+	  else
+	    { I64 listSize  = listLen * li->listEltSize ;
+	      if (type == oneSTRING || li->isUserBuf       // STRING needs a terminating 0
+		  || ((size_t) vf->mapPos & (li->listEltSize-1)))  // misaligned REAL_LIST
+		memcpy (li->buffer, vf->mapPos, listSize) ;
+	      else
+		vf->mapList = vf->mapPos ;
+	      vf->mapPos += listSize ;
+	    }
+	  if (vf->mapPos > vf->mapEnd)
+	    die ("ONE read error: list runs off end of mapped file %s", vf->fileName) ;
+	}
+
+      if (type == oneSTRING)
+	{ if (!li->buffer) // edge case - it may be 0 if all strings in a file are length 0
+	    { li->bufSize = 32 ;
+	      li->buffer = new (32, char) ;
+	    }
+	  ((char *) li->buffer)[listLen] = '\0'; // 0 terminate
+	}
+    }
+
+ doneLine:
+
+  if (vf->mapPos < vf->mapEnd) // check if next line is a comment - if so then read it
+    { U8 peek = *vf->mapPos ;
+      if (peek & 0x80)
+	peek = vf->binaryTypeUnpack[peek];
+      if (peek == '/') // a comment
+	{ OneField keepField0 = vf->field[0] ;
+	  I64   keepNbits = vf->nBits ; // these will be reset in readLine
+	  void *keepList = vf->mapList ;
+	  char *keepCodec = vf->mapCodec ;
+	  oneReadLine (vf) ; // read comment line into vf->info['/']->buffer
+	  vf->lineType = t ;
+	  vf->field[0] = keepField0 ;
+	  vf->nBits = keepNbits ;
+	  vf->mapList = keepList ;
+	  vf->mapCodec = keepCodec ;
+	}
+    }
+}
+
 char oneReadLine (OneFile *vf)
 { bool      isAscii;
-  U8        x;
+  bool      isMapLine = false;
+  U8        x = 0;
   char      t;
   OneInfo  *li;
 
   assert (!vf->isWrite) ;
   assert (!vf->isFinal) ;
 
+#ifdef ONE_STATS // a comment read recursively below counts for '/', not this line
+  OneIOStat *io0 = &vf->info['/']->io ;
+  I64        ns0 = nsNow (), pos0 = vf->mapPos ? vf->mapPos - vf->mapBase : ftello (vf->f) ;
+  I64        cBytes = io0->bytes, cNs = io0->readNs ;
+#endif
+
+  if (vf->prefetch) prefetchNote (vf) ;
+
   vf->linePos = 0;                 // must come before first vfGetc()
-  x = vfGetc (vf);                 // read first char
-  if (feof (vf->f) || x == '\n')   // blank line (x=='\n') is end of records marker before footer
-    { vf->lineType = 0 ;           // additional marker of end of file
-      return 0;
+  vf->mapList = 0 ;
+  vf->mapCodec = 0 ;
+  if (vf->mapPos)                  // in the data of a memory mapped binary file
+    { if (vf->mapPos >= vf->mapEnd || *vf->mapPos == '\n')
+	{ vf->lineType = 0 ;
+	  return 0 ;
+	}
+      if (*vf->mapPos & 0x80)
+	{ x = *vf->mapPos++ ;
+	  vf->lineBuf[vf->linePos++] = x ;
+	  isMapLine = true ;
+	}
+      else if (fseeko (vf->f, vf->mapPos - vf->mapBase, SEEK_SET) != 0) // ascii via stdio
+	die ("ONE read error: failed to seek to ascii line in mapped file") ;
+    }
+
+  if (!isMapLine)
+    { x = vfGetc (vf);               // read first char
+      if (feof (vf->f) || x == '\n') // blank line (x=='\n') is end of records marker before footer
+	{ vf->lineType = 0 ;         // additional marker of end of file
+	  return 0;
+	}
     }
 
   vf->line += 1;      // otherwise assume this is a good line, and die if not
@@ -1169,8 +1761,13 @@ char oneReadLine (OneFile *vf)
             break;
 	  }
       readFlush (vf);
+      if (vf->mapPos) // resynchronise the map after an ascii line
+	vf->mapPos = vf->mapBase + ftello (vf->f) ;
     }
 
+  else if (isMapLine)
+    readLineMap (vf, li, x, t) ;
+
   else        // binary - block read fields and list, potentially compressed
     { 
       // read the fields
@@ -1188,14 +1785,23 @@ char oneReadLine (OneFile *vf)
 	      if (listLen > li->accum.max)
 		li->accum.max = listLen;
 
+	      if (li->isSkipList)
+		{ skipList (vf, li, listLen, x) ;
+		  goto doneLine ;
+		}
+	      if (t == '/') commentBufFit (li, listLen) ;
+
 	      if (li->fieldType[li->listField] == oneINT_LIST)
 		{ *(I64*)li->buffer = ltfRead (vf->f) ;
 		  if (listLen == 1) goto doneLine ;
-		  vf->intListBytes = getc(vf->f) ;
+		  vf->intListBytes = getc_unlocked (vf->f) ;
 		}
 
 	      if (li->fieldType[li->listField] == oneSTRING_LIST) // handle as ASCII
                 readStringList (vf, t, listLen);
+	      else if (li->fieldType[li->listField] == oneINT_LIST
+		       && vf->intListBytes == INT_LIST_PACKED)
+		readPackedIntList (vf, li, listLen) ;
               else if (x & 0x1)    				  // list is compressed
                 { vf->nBits = ltfRead (vf->f) ;
 		  size_t bytes = (vf->nBits+7) >> 3 ;
@@ -1231,7 +1837,7 @@ char oneReadLine (OneFile *vf)
 
     doneLine:
 
-      { U8 peek = getc(vf->f) ; // check if next line is a comment - if so then read it
+      { U8 peek = getc_unlocked (vf->f) ; // check if next line is a comment - if so then read it
 	ungetc(peek, vf->f) ;
 	if (peek & 0x80)
 	  peek = vf->binaryTypeUnpack[peek];
@@ -1246,6 +1852,14 @@ char oneReadLine (OneFile *vf)
       }
     }
 
+#ifdef ONE_STATS
+  li->io.lines += 1 ;
+  li->io.bytes += (vf->mapPos ? vf->mapPos - vf->mapBase : ftello (vf->f)) - pos0 - (io0->bytes - cBytes) ;
+  li->io.readNs += nsNow () - ns0 - (io0->readNs - cNs) ;
+  li->io.rawBytes += li->nField * sizeof(OneField) ;
+  if (li->listEltSize) li->io.rawBytes += oneLen(vf) * li->listEltSize ;
+#endif
+
   return t;
 }
 
@@ -1262,26 +1876,40 @@ void *_oneList (OneFile *vf)
 {
   OneInfo *li = vf->info[(int) vf->lineType] ;
 
+  if (li->isSkipList) return 0 ;
+  
   if (vf->nBits)
-    { if (li->fieldType[li->listField] == oneINT_LIST) // first elt is already in buffer
-	{ vcDecode (li->listCodec, vf->nBits, vf->codecBuf, (char*)&(((I64*)li->buffer)[1])) ;
+    { char *codecBuf = vf->mapCodec ? vf->mapCodec : vf->codecBuf ;
+#ifdef ONE_STATS
+      I64   ns0 = nsNow () ;
+#endif
+      if (li->fieldType[li->listField] == oneINT_LIST) // first elt is already in buffer
+	{ vcDecode (li->listCodec, vf->nBits, codecBuf, (char*)&(((I64*)li->buffer)[1])) ;
 	  decompactIntList (vf, oneLen(vf), li->buffer, vf->intListBytes) ;
 	}
       else
-	vcDecode (li->listCodec, vf->nBits, vf->codecBuf, li->buffer) ;
+	vcDecode (li->listCodec, vf->nBits, codecBuf, li->buffer) ;
+#ifdef ONE_STATS
+      li->io.nDecode += 1 ;
+      li->io.decodeNs += nsNow () - ns0 ;
+#endif
       vf->nBits = 0 ; // so we don't do it again
+      vf->mapCodec = 0 ;
     }
   
-  return li->buffer ;
+  return vf->mapList ? vf->mapList : li->buffer ;
 }
 
 void *_oneCompressedList (OneFile *vf)
 {
   OneInfo *li = vf->info[(int) vf->lineType] ;
 
+  if (vf->mapCodec)                      // still compressed in the mapping
+    return (void*) vf->mapCodec ;
+  
   if (!vf->nBits && oneLen(vf) > 0)      // need to compress
     vf->nBits = vcEncode (li->listCodec, oneLen(vf),
-			  vf->info[(int) vf->lineType]->buffer, vf->codecBuf);
+			  vf->mapList ? vf->mapList : li->buffer, vf->codecBuf);
 
   return (void*) vf->codecBuf ;
 }
@@ -1296,7 +1924,7 @@ OneFile *readThreadMake (OneFile *vfOld, OneSchema *vs0, FILE **files)
   vf[0] = *vfOld ;
   free (vfOld) ; // NB free() not oneFileDestroy because don't want deep destroy
 
-  startOff = ftello (vf->f) ;
+  startOff = vf->mapPos ? vf->mapPos - vf->mapBase : ftello (vf->f) ;
   for (i = 1; i < nthreads; i++)
     { OneSchema *vs = vs0 ; // needed because vs will have changed to map to the relevant page
       OneFile   *v = oneFileCreate(&vs, vf->fileType); // need to do this after header is read
@@ -1309,6 +1937,11 @@ OneFile *readThreadMake (OneFile *vfOld, OneSchema *vs0, FILE **files)
       v->f = files[i] ;
       if (fseeko (v->f, startOff, SEEK_SET) != 0)
 	die ("ONE file error: can't seek to start of data in thread file");
+      if (vf->mapBase) // share the mapping
+	{ v->mapBase = vf->mapBase ;
+	  v->mapEnd  = vf->mapEnd ;
+	  v->mapPos  = vf->mapBase + startOff ;
+	}
       
       for (j = 0; j < 128; j++)
 	{ OneInfo *li = v->info[j];
@@ -1321,7 +1954,7 @@ OneFile *readThreadMake (OneFile *vfOld, OneSchema *vs0, FILE **files)
 	      if (li->listEltSize > 0) // need a private buffer
 		{ li->bufSize = l0->bufSize;
 		  if (li->buffer) free (li->buffer) ;
-		  li->buffer  = new (l0->bufSize*l0->listEltSize, void);
+		  li->buffer  = l0->bufSize ? new (l0->bufSize*l0->listEltSize, void) : 0 ;
 		}
 	      if (l0->isObject) li->isObject = true ;
 	      if (l0->index) // share the index
@@ -1348,6 +1981,81 @@ OneFile *readThreadMake (OneFile *vfOld, OneSchema *vs0, FILE **files)
   return vf ;
 }
 
+/***********************************************************************************
+ *
+ *   GZIP INPUT:
+ *     Gzipped files are presented as stdio streams that read through an Inflater from
+ *     inflater.h, shared with seqio, which inflates the data ahead of the reader on other
+ *     threads.  BGZF files, as made by bgzip, are seekable, so oneGoto() works on compressed
+ *     binary files too.  Plain gzip files can't seek from the end, or cheaply backwards, so
+ *     a binary file must be BGZF.
+ *
+ **********************************************************************************/
+
+static ssize_t gzCookieRead (void *cookie, char *buf, size_t size)
+{
+  I64 n = inflaterRead ((Inflater*) cookie, buf, size) ;
+  if (n < 0) die ("ONE read error: corrupt gzip data") ;
+  return n ;
+}
+
+static int gzCookieSeek (void *cookie, I64 *off, int whence)
+{
+  Inflater *inf = (Inflater*) cookie ;
+  I64       pos = *off ;
+
+  if (whence == SEEK_CUR) pos += inflaterPos (inf) ;
+  else if (whence == SEEK_END)
+    { if (inflaterSize (inf) < 0) return -1 ; // plain gzip
+      pos += inflaterSize (inf) ;
+    }
+  if (!inflaterSeek (inf, pos)) return -1 ;
+  *off = pos ;
+  return 0 ;
+}
+
+static int gzCookieClose (void *cookie)
+{
+  inflaterClose ((Inflater*) cookie) ;
+  return 0 ;
+}
+
+#ifdef __linux__
+static FILE *cookieOpen (Inflater *inf)
+{ cookie_io_functions_t io = { gzCookieRead, 0, (cookie_seek_function_t*) gzCookieSeek, gzCookieClose } ;
+  return fopencookie (inf, "r", io) ;
+}
+#else // BSD and macOS stdio have funopen() instead of fopencookie()
+static int funRead (void *c, char *buf, int n) { return (int) gzCookieRead (c, buf, n) ; }
+static fpos_t funSeek (void *c, fpos_t off, int whence)
+{ I64 x = off ;
+  return (gzCookieSeek (c, &x, whence) < 0) ? -1 : x ;
+}
+static FILE *cookieOpen (Inflater *inf)
+{ return funopen (inf, funRead, 0, funSeek, gzCookieClose) ;
+}
+#endif
+
+  // Opens a file for reading, transparently decompressing it if it is gzipped.  nThread is
+  //   the number of inflater threads for a BGZF file, 0 for the default.  Each chunk is one
+  //   BGZF block, to keep oneGoto() cheap.
+
+static FILE *fopenRead (const char *path, int nThread)
+{
+  Inflater *inf = inflaterOpen (path, nThread, 1) ;
+  FILE     *f = inf ? cookieOpen (inf) : fopen (path, "r") ;
+
+  if (!f)
+    { if (inf) inflaterClose (inf) ;
+      return 0 ;
+    }
+  if (inf) setvbuf (f, 0, _IOFBF, BGZF_BLOCK_MAX) ;
+#ifdef __GLIBC__ // see vfGetc() - this covers ungetc(), fread() and ftello() too
+  __fsetlocking (f, FSETLOCKING_BYCALLER) ;
+#endif
+  return f ;
+}
+
 /***********************************************************************************
  *
  *   ONE_FILE_OPEN_READ:
@@ -1359,6 +2067,26 @@ OneFile *readThreadMake (OneFile *vfOld, OneSchema *vs0, FILE **files)
  *
  **********************************************************************************/
 
+  // Map the whole of a binary file, leaving vf->mapPos at the current (start of data)
+  //   position.  If mmap() fails we silently carry on reading through stdio.
+
+static void mapFile (OneFile *vf)
+{
+  struct stat st ;
+  void       *base ;
+
+  if (fstat (fileno (vf->f), &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+    return ;
+  base = mmap (0, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno (vf->f), 0) ;
+  if (base == MAP_FAILED)
+    return ;
+  madvise (base, st.st_size, MADV_SEQUENTIAL) ;
+
+  vf->mapBase = (char*) base ;
+  vf->mapEnd  = vf->mapBase + st.st_size ;
+  vf->mapPos  = vf->mapBase + ftello (vf->f) ;
+}
+
 OneFile *oneFileOpenRead (const char *path, OneSchema *vsArg, const char *fileType, int nthreads)
 {
   OneFile   *vf ;
@@ -1379,11 +2107,11 @@ OneFile *oneFileOpenRead (const char *path, OneSchema *vsArg, const char *fileTy
     if (strcmp (path, "-") == 0)
       f = stdin;
     else
-      { f = fopen (path, "r");
+      { f = fopenRead (path, 0);
 	if (!f && fileType)
 	  { char *localPath = malloc (strlen(path) + strlen(fileType) + 2) ;
 	    strcpy (localPath, path) ; strcat (localPath, ".") ; strcat (localPath, fileType) ;
-	    f = fopen (localPath, "r") ;
+	    f = fopenRead (localPath, 0) ;
 	  }
 	if (!f) return 0 ;
       }
@@ -1422,6 +2150,7 @@ OneFile *oneFileOpenRead (const char *path, OneSchema *vsArg, const char *fileTy
 	  OPEN_ERROR3("minor version file %d > code %d", minor, MINOR) ;
 	vs0 = vsFile = oneSchemaCreateDynamic (primaryName, 0) ; // create a shell schema
 	vf = oneFileCreate (&vsFile, primaryName)  ;
+	vf->isPacked = (minor > MINOR_UNPACKED) ;
 	free (primaryName) ;
       }
     else
@@ -1603,13 +2332,17 @@ OneFile *oneFileOpenRead (const char *path, OneSchema *vsArg, const char *fileTy
 
           startOff = ftello (vf->f);
           if (fseek (vf->f, -sizeof(off_t), SEEK_END) != 0)
-            die ("ONE file error: can't seek to final line");
+	    { if (fileno (vf->f) < 0) // a stream from cookieOpen() that can't seek - plain gzip
+		die ("ONE file error: binary file %s is plain gzip - recompress it with bgzip", vf->fileName) ;
+	      die ("ONE file error: can't seek to final line");
+	    }
 
           if (fread (&footOff, sizeof(off_t), 1, vf->f) != 1)
             die ("ONE file error: can't read footer offset");
 
           if (fseeko (vf->f, footOff, SEEK_SET) != 0)
             die ("ONE file error: can't seek to start of footer");
+	  vf->footOff = footOff ;
 
           break;
 
@@ -1631,6 +2364,16 @@ OneFile *oneFileOpenRead (const char *path, OneSchema *vsArg, const char *fileTy
           vf->info[(int) oneChar(vf,0)]->listCodec = vcDeserialize (oneString(vf));
           break;
 
+        case '*': // zone map - buffer was sized by a preceding '@ *' line
+	  { OneInfo *li = vf->info[(int) oneChar(vf,0)] ;
+	    if (!li || !li->isObject || oneLen(vf) % (2*li->nField))
+	      parseDie (vf, "bad zone map for line type %c", oneChar(vf,0)) ;
+	    li->zoneBlock = oneInt(vf,1) ;
+	    li->zoneSize  = oneLen(vf) ;
+	    li->zone      = dup (li->zoneSize, oneIntList(vf), I64) ;
+	  }
+          break;
+
         default:
           parseDie (vf, "unknown header line type %c", vf->lineType);
           break;
@@ -1646,8 +2389,14 @@ OneFile *oneFileOpenRead (const char *path, OneSchema *vsArg, const char *fileTy
       return NULL ;
     }
 
-  if (!vf->info[0] || !vf->info[0]->isObject) // will be true if initialiseStats() has been called
-    initialiseStats (vf) ; // call here in case not called above for a % line
+  { int i ; // call here in case not called above for a % line, e.g. ascii without % lines
+    for (i = 'A' ; i <= 'z' ; ++i)
+      if (vf->info[i] && vf->info[i]->isObject && !vf->info[i]->stats) break ;
+    if (i <= 'z' || !vf->info[0]) initialiseStats (vf) ; // also fills the contains[] arrays
+  }
+
+  if (vf->isBinary && vf->f != stdin) // read the data through a memory map if we can
+    mapFile (vf) ;
   
   // allocate codec buffer - always allocate enough to handle fields of all line types
 
@@ -1675,7 +2424,7 @@ OneFile *oneFileOpenRead (const char *path, OneSchema *vsArg, const char *fileTy
 
       if (strcmp (path, "-") == 0) die ("ONE error: parallel input incompatible with stdin as input");
 
-      for (i = 1 ; i < nthreads ; ++i) files[i] = fopen (path, "r") ;
+      for (i = 1 ; i < nthreads ; ++i) files[i] = fopenRead (path, 1) ;
       vf->share = nthreads ;
       vf = readThreadMake (vf, vs0, files) ;
       free (files) ;
@@ -1683,6 +2432,10 @@ OneFile *oneFileOpenRead (const char *path, OneSchema *vsArg, const char *fileTy
 
   if (!isBareFile)
     oneSchemaDestroy (vs0) ;
+
+  { char *env = getenv ("ONE_PREFETCH") ; // read-ahead for every file, window in MB
+    if (env && atoi (env) > 0) oneFilePrefetch (vf, (I64) atoi (env) << 20) ;
+  }
     
   if (localPath != path) free(localPath) ; 
   return vf;
@@ -1727,7 +2480,7 @@ OneFile *oneFileReopenRead (OneFile *vf)
 
 /***********************************************************************************
  *
- *   ONE_USER_BUFFER / GOTO
+ *   ONE_USER_BUFFER / SKIP_LIST / GOTO / PARALLEL_SCAN / READ_BATCH
  *
  **********************************************************************************/
 
@@ -1758,13 +2511,28 @@ void oneUserBuffer (OneFile *vf, char lineType, void *buffer)
     }
 }
 
+bool oneSkipList (OneFile *vf, char lineType, bool isSkip)
+{
+  OneInfo *li = vf->info[(int) lineType] ;
+  int      i, n = (vf->share > 0) ? vf->share : 1 ;
+
+  if (!li || !li->listEltSize || li->fieldType[li->listField] == oneSTRING_LIST)
+    return false ;
+  for (i = 0 ; i < n ; ++i)
+    vf[i].info[(int) lineType]->isSkipList = isSkip ;
+  return true ;
+}
+
 bool oneGoto (OneFile *of, char lineType, I64 i)
 {
   OneInfo *li = of->info[(int)lineType] ;
   if (!li || !li->index || i < 0 || i > li->given.count) return false ;
 
   I64 byte = li->index[i] ;
-  if (fseek (of->f, byte, SEEK_SET) != 0) return false ;
+  if (of->mapPos)
+    of->mapPos = of->mapBase + byte ;
+  else if (fseek (of->f, byte, SEEK_SET) != 0)
+    return false ;
 
   li->accum.count = i ? i-1 : 0 ;
 
@@ -1808,8 +2576,534 @@ I64 oneCountUntilNext (OneFile *of, char countType, char nextType)
   return ix - 1 ;
 }
 
-/***********************************************************************************
- *
+  // Parallel scan driver for oneParallelScan(), one per thread
+
+typedef struct
+{ OneFile     *of ;
+  char         type ;
+  I64          iStart, iEnd ;
+  OneScanFunc *func ;
+  void        *arg ;
+  void        *result ;
+} ScanRange ;
+
+static void *scanThread (void *x)
+{
+  ScanRange *r = (ScanRange*) x ;
+
+  if (!oneGoto (r->of, r->type, r->iStart) || oneReadLine (r->of) != r->type)
+    die ("ONE scan error: failed to go to %c object %lld", r->type, r->iStart) ;
+  r->result = (*r->func) (r->of, r->iStart, r->iEnd, r->arg) ;
+  return 0 ;
+}
+
+void **oneParallelScan (OneFile *of, char objectType, OneScanFunc *func, void *arg)
+{
+  OneInfo   *li = of->info[(int)objectType] ;
+  int        t, nthreads = (of->share > 0) ? of->share : 1 ;
+  I64        n, b0, b1, iStart ;
+  ScanRange *range ;
+  pthread_t *threads ;
+  void     **results ;
+
+  if (of->isWrite || of->share < 0 || !li || !li->index)
+    { snprintf (errorString, 1024, "oneParallelScan needs an indexed %c in a binary read file",
+		objectType) ;
+      return 0 ;
+    }
+  n = li->given.count ;
+  results = new0 (nthreads, void*) ;
+  if (n == 0) return results ;
+
+  // range t ends at the first object starting at or after fraction (t+1)/nthreads of the
+  // bytes between the first and last objects - binary search in the index
+
+  range = new0 (nthreads, ScanRange) ;
+  b0 = li->index[1] ; b1 = li->index[n] ;
+  iStart = 1 ;
+  for (t = 0 ; t < nthreads ; ++t)
+    { I64 iEnd = n+1 ;
+      if (t < nthreads-1)
+	{ I64 target = b0 + (b1 - b0) * (t+1) / nthreads ;
+	  I64 lo = iStart, hi = n+1 ; // find smallest i in [lo,hi) with index[i] >= target
+	  while (lo < hi)
+	    { I64 mid = (lo + hi) / 2 ;
+	      if (li->index[mid] < target) lo = mid + 1 ; else hi = mid ;
+	    }
+	  iEnd = lo ;
+	}
+      range[t].of = of + t ;
+      range[t].type = objectType ;
+      range[t].iStart = iStart ;
+      range[t].iEnd = iEnd ;
+      range[t].func = func ;
+      range[t].arg = arg ;
+      iStart = iEnd ;
+    }
+
+  threads = new (nthreads, pthread_t) ;
+  for (t = 1 ; t < nthreads ; ++t) // run range 0 in this thread
+    if (range[t].iEnd > range[t].iStart)
+      pthread_create (&threads[t], 0, scanThread, &range[t]) ;
+  if (range[0].iEnd > range[0].iStart)
+    scanThread (&range[0]) ;
+  for (t = 1 ; t < nthreads ; ++t)
+    if (range[t].iEnd > range[t].iStart)
+      pthread_join (threads[t], 0) ;
+
+  for (t = 0 ; t < nthreads ; ++t)
+    results[t] = range[t].result ;
+  free (threads) ;
+  free (range) ;
+  return results ;
+}
+
+  // Batch decode of objects into columns for oneReadBatch()
+
+static inline void clearColumn (OneColumn *c, OneType type, I64 k)
+{
+  if (c->field < 0 || (type != oneREAL && type != oneCHAR))
+    ((I64*)c->data)[k] = 0 ;
+  else if (type == oneREAL)
+    ((double*)c->data)[k] = 0 ;
+  else
+    ((char*)c->data)[k] = 0 ;
+}
+
+static inline void setColumn (OneFile *of, OneColumn *c, OneType type, I64 k)
+{
+  if (c->field < 0)
+    ++((I64*)c->data)[k] ;
+  else
+    switch (type)
+      {
+      case oneINT:  ((I64*)c->data)[k] = oneInt(of,c->field) ; break ;
+      case oneREAL: ((double*)c->data)[k] = oneReal(of,c->field) ; break ;
+      case oneCHAR: ((char*)c->data)[k] = oneChar(of,c->field) ; break ;
+      default:      ((I64*)c->data)[k] = of->field[c->field].len & 0xffffffffffffffll ; // lists
+      }
+}
+
+I64 oneReadBatch (OneFile *of, char objectType, I64 n, int nCol, OneColumn *col)
+{
+  OneType *type = new (nCol, OneType) ;
+  bool     isWanted[128], isSkip[128] ;
+  int      i, j ;
+  I64      k ;
+
+  if (of->isWrite || of->lineType != objectType) { free (type) ; return 0 ; }
+
+  memset (isWanted, 0, sizeof(isWanted)) ;
+  for (j = 0 ; j < nCol ; ++j)
+    { OneInfo *li = of->info[(int)col[j].lineType] ;
+      if (!li || col[j].field >= li->nField)
+	die ("ONE batch error: no field %d for line type %c", col[j].field, col[j].lineType) ;
+      type[j] = (col[j].field >= 0) ? li->fieldType[col[j].field] : oneINT ;
+      isWanted[(int)col[j].lineType] = true ;
+    }
+
+  for (i = 0 ; i < 128 ; ++i) // we only want fields, so skip the lists we can while in here
+    if (of->info[i] && i != objectType) // leave the next object line intact for the caller
+      { isSkip[i] = of->info[i]->isSkipList ;
+	if (of->info[i]->listEltSize && of->info[i]->fieldType[of->info[i]->listField] != oneSTRING_LIST)
+	  of->info[i]->isSkipList = true ;
+      }
+
+  for (k = 0 ; k < n && of->lineType == objectType ; ++k)
+    { for (j = 0 ; j < nCol ; ++j)
+	clearColumn (&col[j], type[j], k) ;
+      do
+	if (isWanted[(int)of->lineType])
+	  for (j = 0 ; j < nCol ; ++j)
+	    if (col[j].lineType == of->lineType)
+	      setColumn (of, &col[j], type[j], k) ;
+      while (oneReadLine (of) && of->lineType != objectType) ;
+    }
+
+  for (i = 0 ; i < 128 ; ++i)
+    if (of->info[i] && i != objectType) of->info[i]->isSkipList = isSkip[i] ;
+  free (type) ;
+  return k ;
+}
+
+/******************* cursors ********************/
+
+OneFile *oneCursorCreate (OneFile *of)
+{
+  OneFile *vc ;
+  I64      start = -1 ;
+  int      i ;
+
+  if (of->isWrite || !of->isBinary || of->share < 0 || of->isCursor)
+    { snprintf (errorString, 1024, "cursors need a binary master OneFile open for reading\n") ;
+      return 0 ;
+    }
+
+  for (i = 'A' ; i <= 'z' ; ++i) // index[0] is the start of the data
+    if (of->info[i] && of->info[i]->index)
+      { start = of->info[i]->index[0] ; break ; }
+  if (start < 0)
+    { snprintf (errorString, 1024, "cursors need a file with an object index\n") ;
+      return 0 ;
+    }
+
+  vc = new (1, OneFile) ;
+  *vc = *of ;			// share the header information, file names etc.
+  vc->isCursor = true ;
+  vc->share = 0 ;
+  vc->tempReadFiles = 0 ;
+  vc->prefetch = 0 ;
+  vc->packBuf = 0 ; vc->packBufSize = 0 ;
+  vc->lineType = 0 ; vc->line = 0 ;
+  vc->mapList = 0 ; vc->mapCodec = 0 ;
+  vc->field = new0 (vc->nFieldMax, OneField) ;
+  vc->codecBuf = new (vc->codecBufSize, char) ;
+
+  for (i = 0 ; i < 128 ; ++i)
+    if (of->info[i])
+      { OneInfo *li = new (1, OneInfo) ;
+	*li = *of->info[i] ;	// shares fieldType, listCodec, index and zone
+	li->accum.count = 0 ;
+	memset (&li->io, 0, sizeof(OneIOStat)) ;
+	li->isUserBuf = false ;
+	li->buffer = 0 ; li->bufSize = 0 ;
+	if (li->listEltSize && li->given.max)
+	  { li->bufSize = li->given.max + 1 ; // as for an '@' line when reading the header
+	    li->buffer = new (li->bufSize*li->listEltSize, char) ;
+	  }
+	if (li->stats)
+	  { int n = 1 ; OneStat *st ; for (st = li->stats ; st->type ; ++st) ++n ;
+	    li->stats = dup (n, li->stats, OneStat) ;
+	  }
+	vc->info[i] = li ;
+      }
+
+  if (of->mapBase)
+    { vc->f = 0 ;
+      vc->mapPos = of->mapBase + start ;
+    }
+  else				// read through our own FILE
+    { vc->mapPos = vc->mapEnd = 0 ;
+      if (!(vc->f = fopenRead (of->fileName, 1)) || fseeko (vc->f, start, SEEK_SET) != 0)
+	{ snprintf (errorString, 1024, "cursor failed to open %s\n", of->fileName) ;
+	  oneCursorDestroy (vc) ;
+	  return 0 ;
+	}
+    }
+
+  return vc ;
+}
+
+void oneCursorDestroy (OneFile *vc)
+{
+  int i ;
+  if (!vc->isCursor) die ("ONE error: oneCursorDestroy() called on a OneFile that is not a cursor") ;
+
+  for (i = 0 ; i < 128 ; ++i)
+    if (vc->info[i])
+      { OneInfo *li = vc->info[i] ;
+	if (li->buffer && !li->isUserBuf) free (li->buffer) ;
+	if (li->stats) free (li->stats) ;
+	free (li) ;
+      }
+  if (vc->f) fclose (vc->f) ;
+  if (vc->codecBuf) free (vc->codecBuf) ;
+  if (vc->packBuf) free (vc->packBuf) ;
+  free (vc->field) ;
+  free (vc) ;
+}
+
+/******************* range index ********************/
+
+  // A sidecar binary ONE file of type rix.  For each key (id, start, end fields of the object
+  //   line) there is one c object per id 0..nId-1, holding the intervals on that id sorted by
+  //   start.  Read in that order they are an implicit interval tree, as in Heng Li's cgranges:
+  //   the node at index i has level k, the number of trailing 1 bits of i, with children
+  //   i -/+ 2^(k-1), and m holds the maximum end in each node's subtree.  So a query is one
+  //   oneGoto() into the index plus a descent that only visits subtrees that can overlap.
+
+static char *rangeSchemaText =
+  "P 3 rix                      RANGE INDEX\n"
+  "D n 2 4 CHAR 3 INT           object type indexed, number of objects of that type\n"
+  "D k 4 3 INT 3 INT 3 INT 3 INT  key: id, start and end field numbers, number of ids\n"
+  "O c 1 3 INT                  number of intervals on the next id, for each key in turn\n"
+  "D s 1 8 INT_LIST             interval starts, sorted\n"
+  "D e 1 8 INT_LIST             interval ends, in the same order\n"
+  "D m 1 8 INT_LIST             maximum end in the subtree at each interval\n"
+  "D o 1 8 INT_LIST             object numbers, in the same order\n" ;
+
+struct OneRangeIndexStruct {
+  OneFile *ix ;
+  char     objectType ;
+  int      nKey ;
+  int     *keyField ;		// 3 per key: id, start, end
+  I64     *nId ;		// per key
+  I64     *base ;		// per key: number of c objects before its first one
+  int      curKey ;		// the intervals of curId on curKey are in s, e, m, o
+  I64      curId ;
+  I64      curN ;
+  I64      bufSize ;
+  I64     *s, *e, *m, *o, *hits ;
+} ;
+
+typedef struct { I64 id, start, end, obj ; } RangeEntry ;
+
+static int rangeEntryOrder (const void *a, const void *b)
+{
+  const RangeEntry *x = (const RangeEntry*) a, *y = (const RangeEntry*) b ;
+  if (x->id != y->id) return (x->id < y->id) ? -1 : 1 ;
+  if (x->start != y->start) return (x->start < y->start) ? -1 : 1 ;
+  return (x->obj < y->obj) ? -1 : (x->obj > y->obj) ;
+}
+
+static int i64Order (const void *a, const void *b)
+{
+  I64 x = *(const I64*) a, y = *(const I64*) b ;
+  return (x < y) ? -1 : (x > y) ;
+}
+
+static void rangeTreeMax (I64 n, I64 *e, I64 *m) // e[] in start order, m[] the subtree max ends
+{
+  I64 i, k, lastI = 0, last = 0 ; // lastI is the last node in the tree, maybe beyond n
+
+  for (i = 0 ; i < n ; i += 2) { lastI = i ; last = m[i] = e[i] ; } // the leaves
+  for (k = 1 ; ((I64)1 << k) <= n ; ++k)
+    { I64 x = (I64)1 << (k-1) ;
+      for (i = 2*x - 1 ; i < n ; i += 4*x)
+	{ I64 el = m[i-x], er = (i+x < n) ? m[i+x] : last ;
+	  m[i] = e[i] ;
+	  if (el > m[i]) m[i] = el ;
+	  if (er > m[i]) m[i] = er ;
+	}
+      lastI = ((lastI >> k) & 1) ? lastI - x : lastI + x ;
+      if (lastI < n && m[lastI] > last) last = m[lastI] ;
+    }
+}
+
+bool oneRangeIndexWrite (OneFile *of, const char *indexFileName, char objectType,
+			 int nKey, int *keyField)
+{
+  OneInfo *li = of->info[(int)objectType] ;
+  int      i, j ;
+
+  if (of->isWrite || !li || !li->isObject || nKey <= 0)
+    { snprintf (errorString, 1024, "range index needs an object type %c in a read file\n",
+		objectType) ;
+      return false ;
+    }
+  for (j = 0 ; j < 3*nKey ; ++j)
+    if (keyField[j] < 0 || keyField[j] >= li->nField || li->fieldType[keyField[j]] != oneINT)
+      { snprintf (errorString, 1024, "range index field %d of %c is not an INT\n",
+		  keyField[j], objectType) ;
+	return false ;
+      }
+
+  RangeEntry **entry = new (nKey, RangeEntry*) ;
+  I64          n = 0, nAlloc = 1024, k ;
+  for (j = 0 ; j < nKey ; ++j) entry[j] = new (nAlloc, RangeEntry) ;
+
+  bool isSkip[128] ;		// we only want fields, so skip the lists as oneReadBatch() does
+  for (i = 0 ; i < 128 ; ++i)
+    if (of->info[i])
+      { isSkip[i] = of->info[i]->isSkipList ;
+	if (of->info[i]->listEltSize && of->info[i]->fieldType[of->info[i]->listField] != oneSTRING_LIST)
+	  of->info[i]->isSkipList = true ;
+      }
+
+  while (of->lineType || oneReadLine (of))
+    { if (of->lineType == objectType)
+	{ if (n == nAlloc)
+	    { for (j = 0 ; j < nKey ; ++j) resize (entry[j], nAlloc, 2*nAlloc, RangeEntry) ;
+	      nAlloc *= 2 ;
+	    }
+	  for (j = 0 ; j < nKey ; ++j)
+	    { RangeEntry *r = &entry[j][n] ;
+	      r->id    = oneInt (of, keyField[3*j]) ;
+	      r->start = oneInt (of, keyField[3*j+1]) ;
+	      r->end   = oneInt (of, keyField[3*j+2]) ;
+	      r->obj   = oneObject (of, (int)objectType) ;
+	      if (r->id < 0) die ("ONE range index: negative id %lld in object %lld", r->id, r->obj) ;
+	    }
+	  ++n ;
+	}
+      if (!oneReadLine (of)) break ;
+    }
+
+  for (i = 0 ; i < 128 ; ++i)
+    if (of->info[i]) of->info[i]->isSkipList = isSkip[i] ;
+
+  OneSchema *vs = oneSchemaCreateFromText (rangeSchemaText) ;
+  OneFile   *ix = oneFileOpenWriteNew (indexFileName, vs, "rix", true, 1) ;
+  if (!ix)
+    { for (j = 0 ; j < nKey ; ++j) free (entry[j]) ;
+      free (entry) ;
+      oneSchemaDestroy (vs) ;
+      return false ;
+    }
+  oneAddReference (ix, of->fileName, n) ;
+
+  oneChar(ix,0) = objectType ; oneInt(ix,1) = n ;
+  oneWriteLine (ix, 'n', 0, 0) ;
+  I64 *nId = new (nKey, I64) ;
+  for (j = 0 ; j < nKey ; ++j)
+    { qsort (entry[j], n, sizeof(RangeEntry), rangeEntryOrder) ;
+      nId[j] = n ? entry[j][n-1].id + 1 : 0 ;
+      oneInt(ix,0) = keyField[3*j] ; oneInt(ix,1) = keyField[3*j+1] ;
+      oneInt(ix,2) = keyField[3*j+2] ; oneInt(ix,3) = nId[j] ;
+      oneWriteLine (ix, 'k', 0, 0) ;
+    }
+
+  I64 *buf = new (n ? n : 1, I64), *buf2 = new (n ? n : 1, I64) ;
+  for (j = 0 ; j < nKey ; ++j)
+    { RangeEntry *r = entry[j], *rEnd = entry[j] + n ;
+      I64 id ;
+      for (id = 0 ; id < nId[j] ; ++id)
+	{ RangeEntry *r0 = r ;
+	  while (r < rEnd && r->id == id) ++r ;
+	  oneInt(ix,0) = r - r0 ;
+	  oneWriteLine (ix, 'c', 0, 0) ;
+	  if (r == r0) continue ;
+	  for (k = 0 ; k < r - r0 ; ++k) buf[k] = r0[k].start ;
+	  oneWriteLine (ix, 's', r - r0, buf) ;
+	  for (k = 0 ; k < r - r0 ; ++k) buf[k] = r0[k].end ;
+	  oneWriteLine (ix, 'e', r - r0, buf) ;
+	  rangeTreeMax (r - r0, buf, buf2) ;
+	  oneWriteLine (ix, 'm', r - r0, buf2) ;
+	  for (k = 0 ; k < r - r0 ; ++k) buf[k] = r0[k].obj ;
+	  oneWriteLine (ix, 'o', r - r0, buf) ;
+	}
+      free (entry[j]) ;
+    }
+
+  oneFileClose (ix) ;
+  oneSchemaDestroy (vs) ;
+  free (buf) ; free (buf2) ; free (nId) ; free (entry) ;
+  return true ;
+}
+
+OneRangeIndex *oneRangeIndexRead (const char *indexFileName, OneFile *of)
+{
+  OneSchema *vs = oneSchemaCreateFromText (rangeSchemaText) ;
+  OneFile   *ix = oneFileOpenRead (indexFileName, vs, "rix", 1) ;
+  oneSchemaDestroy (vs) ;
+  if (!ix) return 0 ;
+  if (!ix->isBinary || !ix->info['c']->index)
+    { snprintf (errorString, 1024, "range index %s is not a binary ONE file\n", indexFileName) ;
+      oneFileClose (ix) ;
+      return 0 ;
+    }
+
+  OneRangeIndex *rx = new0 (1, OneRangeIndex) ;
+  I64            n = -1, nObj = 0 ;
+  rx->ix = ix ;
+  rx->curKey = -1 ;
+  while (oneReadLine (ix) && ix->lineType != 'c')
+    if (ix->lineType == 'n')
+      { rx->objectType = oneChar(ix,0) ; n = oneInt(ix,1) ; }
+    else if (ix->lineType == 'k')
+      { int j = rx->nKey++ ;
+	resize (rx->keyField, 3*j, 3*(j+1), int) ;
+	resize (rx->nId, j, j+1, I64) ;
+	resize (rx->base, j, j+1, I64) ;
+	rx->keyField[3*j] = oneInt(ix,0) ;
+	rx->keyField[3*j+1] = oneInt(ix,1) ;
+	rx->keyField[3*j+2] = oneInt(ix,2) ;
+	rx->nId[j] = oneInt(ix,3) ;
+	rx->base[j] = j ? rx->base[j-1] + rx->nId[j-1] : 0 ;
+      }
+
+  if (of && of->isBinary && of->info[(int)rx->objectType])
+    nObj = of->info[(int)rx->objectType]->given.count ;
+  if (of && of->isBinary && n != nObj) // a cheap check that the index was made from this file
+    { snprintf (errorString, 1024, "range index %s has %lld %c objects, not %lld - out of date?\n",
+		indexFileName, n, rx->objectType, nObj) ;
+      oneRangeIndexDestroy (rx) ;
+      return 0 ;
+    }
+
+  return rx ;
+}
+
+char oneRangeIndexType (OneRangeIndex *rx) { return rx->objectType ; }
+
+void oneRangeIndexDestroy (OneRangeIndex *rx)
+{
+  oneFileClose (rx->ix) ;
+  free (rx->keyField) ; free (rx->nId) ; free (rx->base) ;
+  if (rx->bufSize)
+    { free (rx->s) ; free (rx->e) ; free (rx->m) ; free (rx->o) ; free (rx->hits) ; }
+  free (rx) ;
+}
+
+static void rangeLoad (OneRangeIndex *rx, int key, I64 id) // read the intervals of id on key
+{
+  OneFile *ix = rx->ix ;
+  I64      n ;
+
+  if (!oneGoto (ix, 'c', rx->base[key] + id + 1) || !oneReadLine (ix) || ix->lineType != 'c')
+    die ("ONE range index: failed to read id %lld for key %d", id, key) ;
+  rx->curKey = key ; rx->curId = id ;
+  rx->curN = n = oneInt(ix,0) ;
+  if (!n) return ;
+
+  if (n > rx->bufSize)
+    { if (rx->bufSize)
+	{ free (rx->s) ; free (rx->e) ; free (rx->m) ; free (rx->o) ; free (rx->hits) ; }
+      rx->bufSize = n ;
+      rx->s = new (n, I64) ; rx->e = new (n, I64) ; rx->m = new (n, I64) ;
+      rx->o = new (n, I64) ; rx->hits = new (n, I64) ;
+    }
+  if (!oneReadLine (ix) || ix->lineType != 's') die ("ONE range index: missing s line") ;
+  memcpy (rx->s, oneIntList(ix), n*sizeof(I64)) ;
+  if (!oneReadLine (ix) || ix->lineType != 'e') die ("ONE range index: missing e line") ;
+  memcpy (rx->e, oneIntList(ix), n*sizeof(I64)) ;
+  if (!oneReadLine (ix) || ix->lineType != 'm') die ("ONE range index: missing m line") ;
+  memcpy (rx->m, oneIntList(ix), n*sizeof(I64)) ;
+  if (!oneReadLine (ix) || ix->lineType != 'o') die ("ONE range index: missing o line") ;
+  memcpy (rx->o, oneIntList(ix), n*sizeof(I64)) ;
+}
+
+I64 oneRangeQuery (OneRangeIndex *rx, int key, I64 id, I64 start, I64 end, I64 **objects)
+{
+  I64 n, i, i1, h = 0 ;
+  int k = 0, t = 0 ;
+  struct { I64 x ; int k ; bool isLeftDone ; } stack[64], z ;
+
+  *objects = 0 ;
+  if (key < 0 || key >= rx->nKey || id < 0 || id >= rx->nId[key]) return 0 ;
+  if (key != rx->curKey || id != rx->curId) rangeLoad (rx, key, id) ;
+  if (!(n = rx->curN)) return 0 ;
+
+  while (((I64)2 << k) <= n) ++k ; // the root is at level floor(log2(n))
+  stack[t].x = ((I64)1 << k) - 1 ; stack[t].k = k ; stack[t++].isLeftDone = false ;
+  while (t)
+    { z = stack[--t] ;
+      if (z.k <= 3)		// a small subtree - scan it
+	{ i = z.x >> z.k << z.k ;
+	  i1 = i + ((I64)2 << z.k) - 1 ;
+	  if (i1 > n) i1 = n ;
+	  for ( ; i < i1 && rx->s[i] < end ; ++i)
+	    if (rx->e[i] > start) rx->hits[h++] = rx->o[i] ;
+	}
+      else if (!z.isLeftDone)	// come back to z after its left child, which may be beyond n
+	{ I64 y = z.x - ((I64)1 << (z.k-1)) ;
+	  stack[t] = z ; stack[t++].isLeftDone = true ;
+	  if (y >= n || rx->m[y] > start)
+	    { stack[t].x = y ; stack[t].k = z.k-1 ; stack[t++].isLeftDone = false ; }
+	}
+      else if (z.x < n && rx->s[z.x] < end) // z itself, then its right child
+	{ if (rx->e[z.x] > start) rx->hits[h++] = rx->o[z.x] ;
+	  stack[t].x = z.x + ((I64)1 << (z.k-1)) ; stack[t].k = z.k-1 ; stack[t++].isLeftDone = false ;
+	}
+    }
+  qsort (rx->hits, h, sizeof(I64), i64Order) ;
+
+  *objects = rx->hits ;
+  return h ;
+}
+
+/***********************************************************************************
+ *
  *   ONE_OPEN_WRITE_(NEW | FROM)
  *
  **********************************************************************************/
@@ -1871,6 +3165,7 @@ OneFile *oneFileOpenWriteNew (const char *path, OneSchema *vs, const char *fileT
   vf->fileName = strdup (path) ;
   vf->isWrite  = true;
   vf->isBinary = isBinary;
+  vf->isPackable = isBinary && ftello (f) == 0 && !fseeko (f, 0, SEEK_SET) ;
   vf->isLastLineBinary = true; // we don't want to add a newline before the first true line
   
   vf->codecBufSize = vf->nFieldMax*sizeof(OneField) + 1;
@@ -1899,6 +3194,7 @@ OneFile *oneFileOpenWriteNew (const char *path, OneSchema *vs, const char *fileT
 
 	  v->isWrite  = true;
 	  v->isBinary = isBinary;
+	  v->isPackable = vf->isPackable;
           v->isLastLineBinary = isBinary;
 	  
 	  v->codecBufSize = vf->codecBufSize;
@@ -1918,6 +3214,9 @@ OneFile *oneFileOpenWriteNew (const char *path, OneSchema *vs, const char *fileT
             die ("ONEfile error: cannot create temporary file %s for parallel write", name) ;
 	  if (unlink(tempPath) < 0)
 	    die ("ONEfile error: failed to unlink temporary file %s for parallel write", name) ;
+#ifdef __GLIBC__ // only the slave's own thread writes f, so skip the stdio lock as in fopenRead()
+	  __fsetlocking (f, FSETLOCKING_BYCALLER) ;
+#endif
 	  v->f = f ;
 
 	  vf[i] = *v ;
@@ -1926,6 +3225,10 @@ OneFile *oneFileOpenWriteNew (const char *path, OneSchema *vs, const char *fileT
     }
 
   free (tempPath) ;
+
+  char *codecs = getenv ("ONE_CODECS") ; // pretrained codecs for every file of their type
+  if (codecs && isBinary) oneCodecsLoad (vf, codecs) ;
+
   return vf;
 }
 
@@ -2052,6 +3355,94 @@ bool oneFileCheckSchemaText (OneFile *vf, const char *textSchema)
   return isCheck ;
 }
 
+/***********************************************************************************
+ *
+ *    PRETRAINED CODECS
+ *
+ **********************************************************************************/
+
+static char *codecSchemaText =
+  "P 5 codec                    TRAINED LIST CODECS\n"
+  "D t 1 6 STRING               primary file type the codecs were trained on\n"
+  "D c 2 4 CHAR 6 STRING        line type, serialized codec for its list\n" ;
+
+static inline bool isSavedCodec (OneInfo *li) // footer line types are left to train their own
+{ return li && li->listCodec && li->listCodec != DNAcodec
+    && li->fieldType[li->listField] != oneSTRING_LIST ;
+}
+
+bool oneCodecsWrite (OneFile *vf, const char *fileName)
+{
+  int  i, n = 0 ;
+
+  for (i = 'A' ; i <= 'z' ; ++i)
+    if (isalpha(i) && isSavedCodec (vf->info[i]) && vcHasCodec (vf->info[i]->listCodec))
+      ++n ;
+  if (!n)
+    { snprintf (errorString, 1024, "no trained codecs in %s to save\n", vf->fileName) ;
+      return false ;
+    }
+
+  OneSchema *vs = oneSchemaCreateFromText (codecSchemaText) ;
+  OneFile   *vc = oneFileOpenWriteNew (fileName, vs, "codec", true, 1) ;
+  oneSchemaDestroy (vs) ;
+  if (!vc) return false ;
+
+  char *buf = new (vcMaxSerialSize()+1, char) ;
+  oneWriteLine (vc, 't', strlen(vf->fileType), vf->fileType) ;
+  for (i = 'A' ; i <= 'z' ; ++i)
+    if (isalpha(i) && isSavedCodec (vf->info[i]) && vcHasCodec (vf->info[i]->listCodec))
+      { oneChar(vc,0) = i ;
+	oneWriteLine (vc, 'c', vcSerialize (vf->info[i]->listCodec, buf), buf) ;
+      }
+  free (buf) ;
+  oneFileClose (vc) ;
+  return true ;
+}
+
+bool oneCodecsLoad (OneFile *vf, const char *fileName)
+{
+  int i, t, n = 0 ;
+
+  if (!vf->isWrite || !vf->isBinary || vf->share < 0 || vf->isHeaderOut)
+    { snprintf (errorString, 1024, "can only load codecs into a binary master file before writing\n") ;
+      return false ;
+    }
+
+  OneSchema *vs = oneSchemaCreateFromText (codecSchemaText) ;
+  OneFile   *vc = oneFileOpenRead (fileName, vs, "codec", 1) ;
+  oneSchemaDestroy (vs) ;
+  if (!vc) return false ;
+
+  while (oneReadLine (vc))
+    if (vc->lineType == 't' && strcmp (oneString(vc), vf->fileType))
+      { snprintf (errorString, 1024, "codecs in %s are for file type %s not %s\n",
+		  fileName, oneString(vc), vf->fileType) ;
+	break ;
+      }
+    else if (vc->lineType == 'c' && isalpha(t = oneChar(vc,0)) && isSavedCodec (vf->info[t]))
+      { OneInfo *li = vf->info[t] ;
+	vcDestroy (li->listCodec) ;
+	li->listCodec = vcDeserialize (oneString(vc)) ;
+	li->isUseListCodec = true ;
+	for (i = 1 ; i < vf->share ; ++i) // slaves share the master's codec, as after training
+	  { vcDestroy (vf[i].info[t]->listCodec) ;
+	    vf[i].info[t]->listCodec = li->listCodec ;
+	    vf[i].info[t]->isUseListCodec = true ;
+	  }
+	++n ;
+      }
+  bool isOK = (vc->lineType == 0) ; // reached the end without a type mismatch
+  oneFileClose (vc) ;
+
+  if (isOK && !n)
+    { snprintf (errorString, 1024, "no usable codecs for %s in %s\n", vf->fileType, fileName) ;
+      return false ;
+    }
+  if (isOK) oneAddReference (vf, fileName, 0) ;
+  return isOK ;
+}
+
 /***********************************************************************************
  *
  *    SETTING UP PROVENANCE, REFERENCES, & DEFERRALS
@@ -2192,12 +3583,149 @@ bool  oneStatsContains (OneFile *of, char objectType, char lineType, I64 *maxCou
   return true ;
 }
 
+bool oneReportStats (OneFile *of, FILE *f)
+{
+#ifndef ONE_STATS
+  fprintf (f, "no I/O counters for %s - ONElib was compiled without ONE_STATS\n", of->fileName) ;
+  return false ;
+#else
+  OneIOStat  sum, tot ;
+  int        i, k, n = (of->share > 0) ? of->share : 1 ; // sum over threads for a master
+
+  memset (&tot, 0, sizeof(OneIOStat)) ;
+  fprintf (f, "I/O counters for %s\n", of->fileName) ;
+  fprintf (f, "type        lines         bytes     raw bytes   raw/file   decodes  decode ms  decompacts   unpacks    read ms\n") ;
+  for (i = 0 ; i < 128 ; ++i)
+    { if (!of->info[i]) continue ;
+      memset (&sum, 0, sizeof(OneIOStat)) ;
+      for (k = 0 ; k < n ; ++k)
+	{ OneIOStat *io = &of[k].info[i]->io ;
+	  sum.lines += io->lines ; sum.bytes += io->bytes ; sum.rawBytes += io->rawBytes ;
+	  sum.nDecode += io->nDecode ; sum.decodeNs += io->decodeNs ;
+	  sum.nDecompact += io->nDecompact ; sum.nUnpack += io->nUnpack ; sum.readNs += io->readNs ;
+	}
+      if (!sum.lines) continue ;
+      fprintf (f, "  %c  %12lld  %12lld  %12lld  %9.2f  %8lld  %9.1f  %10lld  %8lld  %9.1f\n", i,
+	       sum.lines, sum.bytes, sum.rawBytes, sum.bytes ? sum.rawBytes / (double) sum.bytes : 0.0,
+	       sum.nDecode, sum.decodeNs * 1e-6, sum.nDecompact, sum.nUnpack, sum.readNs * 1e-6) ;
+      tot.lines += sum.lines ; tot.bytes += sum.bytes ; tot.rawBytes += sum.rawBytes ;
+      tot.nDecode += sum.nDecode ; tot.decodeNs += sum.decodeNs ;
+      tot.nDecompact += sum.nDecompact ; tot.nUnpack += sum.nUnpack ; tot.readNs += sum.readNs ;
+    }
+  fprintf (f, "all  %12lld  %12lld  %12lld  %9.2f  %8lld  %9.1f  %10lld  %8lld  %9.1f\n",
+	   tot.lines, tot.bytes, tot.rawBytes, tot.bytes ? tot.rawBytes / (double) tot.bytes : 0.0,
+	   tot.nDecode, tot.decodeNs * 1e-6, tot.nDecompact, tot.nUnpack, tot.readNs * 1e-6) ;
+  return true ;
+#endif
+}
+
 /***********************************************************************************
  *
  *   ONE_WRITE_HEADER / FOOTER
  *
  **********************************************************************************/
 
+  // The zone map holds, for each block of ZONE_BLOCK objects of a type, the min and max of
+  //   each field of the object line (0,0 for non-INT fields), so readers can skip blocks.
+  //   Slaves make their own in local object numbers, merged by zoneMerge() at the end, with
+  //   smaller blocks so that they stay tight where they straddle the master's blocks.
+
+#define ZONE_BLOCK       1024
+#define ZONE_SLAVE_BLOCK   64
+
+static void zoneUpdate (OneFile *vf, OneInfo *li) // li is the object just started
+{
+  I64  n = li->accum.count - 1, nf = li->nField, b, *z ;
+  int  i ;
+
+  if (!li->zoneBlock) // first object - only keep a zone map if there are INT fields
+    { for (i = 0 ; i < nf ; ++i) if (li->fieldType[i] == oneINT) break ;
+      li->zoneBlock = (i == nf) ? -1 : (vf->share < 0) ? ZONE_SLAVE_BLOCK : ZONE_BLOCK ;
+      if (li->zoneBlock < 0) return ;
+    }
+  b = n / li->zoneBlock ;
+  if ((b+1)*2*nf > li->zoneSize)
+    { I64 oldSize = li->zoneSize ;
+      li->zoneSize = 2*(b+1)*2*nf ;
+      resize (li->zone, oldSize, li->zoneSize, I64) ;
+    }
+  z = li->zone + b*2*nf ;
+  for (i = 0 ; i < nf ; ++i, z += 2)
+    if (li->fieldType[i] != oneINT)
+      z[0] = z[1] = 0 ;
+    else if (n % li->zoneBlock == 0) // first object in the block
+      z[0] = z[1] = vf->field[i].i ;
+    else
+      { if (vf->field[i].i < z[0]) z[0] = vf->field[i].i ;
+	if (vf->field[i].i > z[1]) z[1] = vf->field[i].i ;
+      }
+}
+
+static void zoneFold (OneInfo *li, I64 *zk0, I64 Kk, I64 j0, I64 nk, I64 off)
+{ // fold zone map zk0, in blocks of Kk, for local objects j0..nk-1 (0-based) into li's zone
+  //   map as objects off+j - li->zoneBlock must be set, and folds must come in object order
+  I64 nf = li->nField, K = li->zoneBlock, nb = (off + nk + K-1) / K, j, b, f ;
+
+  if (nb*2*nf > li->zoneSize)
+    { I64 oldSize = li->zoneSize ;
+      li->zoneSize = nb*2*nf ;
+      resize (li->zone, oldSize, li->zoneSize, I64) ;
+    }
+  for (j = j0 - j0 % Kk ; j < nk ; j += Kk) // local block j/Kk covers global objects g0..g1
+    { I64 *zk = zk0 + (j/Kk)*2*nf ;
+      I64  g0 = off + ((j > j0) ? j : j0), g1 = off + ((j+Kk < nk) ? j+Kk : nk) - 1 ;
+      for (b = g0/K ; b <= g1/K ; ++b) // a superset is fine, so no need to split blocks
+	{ I64 *z = li->zone + b*2*nf ;
+	  if (b*K >= g0) // no earlier object is in block b
+	    memcpy (z, zk, 2*nf*sizeof(I64)) ;
+	  else
+	    for (f = 0 ; f < 2*nf ; f += 2)
+	      { if (zk[f] < z[f]) z[f] = zk[f] ;
+		if (zk[f+1] > z[f+1]) z[f+1] = zk[f+1] ;
+	      }
+	}
+    }
+}
+
+static void zoneMerge (OneFile *vf, int t, I64 n0, int nthreads)
+{ // fold the slaves' zone maps into the master's, once li->accum.count is the total
+  OneInfo *li = vf->info[t] ;
+  I64      off = n0 ;
+  int      k ;
+
+  if (li->zoneBlock < 0) return ;
+  for (k = 1 ; k < nthreads ; ++k)
+    if (vf[k].info[t]->zoneBlock > 0) break ;
+  if (k == nthreads) return ; // no slave made a zone map
+
+  li->zoneBlock = ZONE_BLOCK ;
+  for (k = 1 ; k < nthreads ; ++k)
+    { OneInfo *lk = vf[k].info[t] ;
+      if (lk->accum.count)
+	zoneFold (li, lk->zone, lk->zoneBlock, 0, lk->accum.count, off) ;
+      off += lk->accum.count ;
+    }
+}
+
+I64 oneZoneBlocks (OneFile *of, char objectType, I64 *blockSize)
+{
+  OneInfo *li = of->info[(int)objectType] ;
+  if (!li || !li->zone || li->zoneBlock <= 0) return 0 ;
+  if (blockSize) *blockSize = li->zoneBlock ;
+  return li->zoneSize / (2*li->nField) ;
+}
+
+bool oneZoneRange (OneFile *of, char objectType, I64 block, int field, I64 *min, I64 *max)
+{
+  OneInfo *li = of->info[(int)objectType] ;
+  if (block < 0 || block >= oneZoneBlocks (of, objectType, 0) || field < 0
+      || field >= li->nField || li->fieldType[field] != oneINT)
+    return false ;
+  I64 *z = li->zone + (block*li->nField + field)*2 ;
+  *min = z[0] ; *max = z[1] ;
+  return true ;
+}
+
 static bool writeCounts (OneFile *vf, int i) // always write counts in ascii
 {
   OneInfo *li = vf->info[i] ;
@@ -2231,7 +3759,10 @@ static void writeHeader (OneFile *vf)
 
   vf->isLastLineBinary = false; // header is in ASCII
 
-  fprintf (vf->f, "1 %lu %s %d %d", strlen(vf->fileType), vf->fileType, MAJOR, MINOR);
+  if (vf->isPackable) // record where the minor version goes, in case a list gets packed
+    vf->minorPos = ftello (vf->f) + snprintf (0, 0, "1 %lu %s %d ", strlen(vf->fileType),
+					      vf->fileType, MAJOR) ;
+  fprintf (vf->f, "1 %lu %s %d %d", strlen(vf->fileType), vf->fileType, MAJOR, MINOR_UNPACKED);
   if (vf->subType)
     fprintf (vf->f, "\n2 %lu %s", strlen(vf->subType), vf->subType);
 
@@ -2363,6 +3894,26 @@ static inline void closeObjects (OneFile *vf, char t) // set count0 for any obje
   vf->info[(int) t]->isFirst = false ;
 }
  
+static void binaryLineStart (OneFile *vf) // write the header if needed, end any ascii line
+{
+  int i ;
+  
+  if (!vf->isHeaderOut && vf->share >= 0) // no header on slaves
+    { writeHeader (vf) ;
+      if (!vf->isLastLineBinary) // copied from below because need to set vf->byte before writing the index for object 0
+	{ fputc ('\n', vf->f) ;
+	  vf->byte = ftello (vf->f) ;
+	}
+      for (i = 'A' ; i <= 'z' ; i++) // write index[0] to be here at start of data
+	if (vf->info[i] && vf->info[i]->index)
+	  vf->info[i]->index[0] = vf->byte ;  // OK to only do this for master - slaves start at 0
+    }
+  else if (!vf->isLastLineBinary)
+    { fputc ('\n', vf->f) ;
+      vf->byte = ftello (vf->f) ;
+    }
+}
+
 // process is to fill fields by assigning to macros, then call - list contents are in buf
 // NB in ASCII mode adds '\n' before writing line not after, so oneWriteComment() can add to line
 // first call will write initial header
@@ -2396,20 +3947,7 @@ void oneWriteLine (OneFile *vf, char t, I64 listLen, void *listBuf)
   if (vf->isBinary)
     { U8  x;
 
-      if (!vf->isHeaderOut && vf->share >= 0) // no header on slaves
-	{ writeHeader (vf) ;
-	  if (!vf->isLastLineBinary) // copied from below because need to set vf->byte before writing the index for object 0
-	    { fputc ('\n', vf->f) ;
-	      vf->byte = ftello (vf->f) ;
-	    }
-	  for (i = 'A' ; i <= 'z' ; i++) // write index[0] to be here at start of data
-	    if (vf->info[i] && vf->info[i]->index)
-	      vf->info[i]->index[0] = vf->byte ;  // OK to only do this for master - slaves start at 0
-	}
-      else if (!vf->isLastLineBinary)
-	{ fputc ('\n', vf->f) ;
-	  vf->byte = ftello (vf->f) ;
-	}
+      binaryLineStart (vf) ;
 
       if (li->isObject) // update index
 	{ if (li->accum.count >= li->indexSize)
@@ -2419,13 +3957,45 @@ void oneWriteLine (OneFile *vf, char t, I64 listLen, void *listBuf)
 	    }
 	  li->index[li->accum.count] = vf->byte ;
           // assert (ftello (vf->f) == vf->byte) ; // beware - very costly
+	  if (li->zoneBlock >= 0) zoneUpdate (vf, li) ;
 	}
 
-      // write the line character
-      
+      // prepare INT_LIST first, because packing changes the line character
+
       x = li->binaryTypePack;   //  Binary line code + compression flags
       if (li->isUseListCodec)
         x |= 0x01;
+
+      bool isPacked = false ;
+      I64  nBits = 0, packSize = -1, first = 0 ;
+      int  listBytes = li->listEltSize ;
+
+      if (li->listEltSize && listLen > 0 && li->fieldType[li->listField] == oneINT_LIST)
+	first = *(I64*)listBuf ; // compactIntList() can overwrite this
+      if (li->listEltSize && listLen > 1 && li->fieldType[li->listField] == oneINT_LIST)
+	{ listBuf = compactIntList (vf, li, listLen, listBuf, &listBytes, &packSize) ;
+	  I64 listSize = (listLen-1) * listBytes ;
+	  if (packSize >= 0 && packSize < listSize) // else packing can't win
+	    { I64 size = listSize ;
+	      if (x & 0x1)
+		{ if (listSize >= vf->codecBufSize)
+		    { free (vf->codecBuf);
+		      vf->codecBufSize = listSize+1;
+		      vf->codecBuf     = new (vf->codecBufSize, void);
+		    }
+		  nBits = vcEncode (li->listCodec, listSize, listBuf, vf->codecBuf);
+		  size = (nBits+7) >> 3 ;
+		}
+	      if (packSize < size)
+		{ isPacked = true ;
+		  vf->isPacked = true ;
+		  x &= ~0x01 ;
+		}
+	    }
+	}
+
+      // write the line character
+
       fputc (x, vf->f);
       ++vf->byte ;
 
@@ -2437,92 +4007,97 @@ void oneWriteLine (OneFile *vf, char t, I64 listLen, void *listBuf)
       // write the list if there is one
 
       if (li->listEltSize && listLen > 0)
-        { I64 nBits, listSize;
-	  int listBytes ;
+        { I64 listSize;
 
 	  li->accum.total += listLen;
           if (listLen > li->accum.max)
             li->accum.max = listLen;
 	  
 	  if (li->fieldType[li->listField] == oneINT_LIST)
-	    { vf->byte += ltfWrite (*(I64*)listBuf, vf->f) ;
+	    { vf->byte += ltfWrite (first, vf->f) ;
 	      if (listLen == 1) goto doneLine ; // finish writing this line here
-	      listBuf = compactIntList (vf, li, listLen, listBuf, &listBytes) ;
 	      --listLen ;
-	      fputc ((char)listBytes, vf->f) ;
+	      fputc (isPacked ? INT_LIST_PACKED : (char)listBytes, vf->f) ;
 	      vf->byte++ ;
 	    }
-	  else
-	    listBytes = li->listEltSize ;
 	  listSize  = listLen * listBytes;
 	  
 	  if (li->fieldType[li->listField] == oneSTRING_LIST) // handle as ASCII
 	    vf->byte += writeStringList (vf, t, listLen, listBuf);
+	  else if (isPacked)
+	    { vf->byte += ltfWrite (packSize, vf->f) ;
+	      if (fwrite (vf->packBuf, packSize, 1, vf->f) != 1)
+		die ("ONE write error: failed to write packed list size %lld", packSize);
+	      vf->byte += packSize ;
+	    }
 	  else if (x & 0x1)
-	    { if (listSize >= vf->codecBufSize)
-		{ free (vf->codecBuf);
-		  vf->codecBufSize = listSize+1;
-		  vf->codecBuf     = new (vf->codecBufSize, void);
+	    { if (!nBits) // may have been encoded above
+		{ if (listSize >= vf->codecBufSize)
+		    { free (vf->codecBuf);
+		      vf->codecBufSize = listSize+1;
+		      vf->codecBuf     = new (vf->codecBufSize, void);
+		    }
+		  nBits = vcEncode (li->listCodec, listSize, listBuf, vf->codecBuf);
 		}
-	      nBits = vcEncode (li->listCodec, listSize, listBuf, vf->codecBuf);
 	      vf->byte += ltfWrite (nBits, vf->f) ;
 	      if (fwrite (vf->codecBuf, ((nBits+7) >> 3), 1, vf->f) != 1)
 		die ("ONE write error: failed to write compressed list nBits %lld", nBits);
 	      vf->byte += ((nBits+7) >> 3) ;
 	    }
+	  else if (fwrite (listBuf, listSize, 1, vf->f) != 1)
+	    die ("ONE write error: failed to write list field %d listLen %lld listSize %lld listBuf %lx",
+		 li->listField, listLen, listSize, listBuf);
 	  else
-	    { if (fwrite (listBuf, listSize, 1, vf->f) != 1)
-		die ("ONE write error: failed to write list field %d listLen %lld listSize %lld listBuf %lx",
-		     li->listField, listLen, listSize, listBuf);
-	      vf->byte += listSize;
-	      if (li->listCodec != NULL)
-		{ vcAddToTable (li->listCodec, listSize, listBuf);
-		  li->listTack += listSize;
-		  
-		  if (li->listTack > vf->codecTrainingSize)
-		    { if (vf->share == 0)
-			{ vcCreateCodec (li->listCodec, 1);
-			  li->isUseListCodec = true;
+	    vf->byte += listSize;
+
+	  if (li->listCodec != NULL && !li->isUseListCodec  // train on the bytes, even if packed
+	      && li->fieldType[li->listField] != oneSTRING_LIST)
+	    { vcAddToTable (li->listCodec, listSize, listBuf);
+	      li->listTack += listSize;
+	      
+	      if (li->listTack > vf->codecTrainingSize)
+		{ if (vf->share == 0)
+		    { vcCreateCodec (li->listCodec, 1);
+		      li->isUseListCodec = true;
+		    }
+		  else
+		    { OneFile  *ms;
+		      OneInfo *lx;
+		      
+		      if (vf->share < 0)
+			{ ms = vf + vf->share;
+			  lx = ms->info[(int) t]; 
 			}
 		      else
-			{ OneFile  *ms;
-			  OneInfo *lx;
-			  
-			  if (vf->share < 0)
-			    { ms = vf + vf->share;
-			      lx = ms->info[(int) t]; 
-			    }
-			  else
-			    { ms = vf;
-			      lx = li;
+			{ ms = vf;
+			  lx = li;
+			}
+		      
+		      pthread_mutex_lock(&ms->listLock);
+		      
+		      if ( ! li->isUseListCodec)
+			
+			{ if (vf->share < 0)
+			    { lx->listTack += li->listTack;
+			      li->listTack = 0;
 			    }
-			  
-			  pthread_mutex_lock(&ms->listLock);
-			  
-			  if ( ! li->isUseListCodec)
-			    
-			    { if (vf->share < 0)
-				{ lx->listTack += li->listTack;
-				  li->listTack = 0;
-				}
-			      if (lx->listTack > ms->codecTrainingSize)
-				{ for (i = 1; i < ms->share; i++)
-				    vcAddHistogram (lx->listCodec,
-						    ms[i].info[(int) t]->listCodec);
-				  vcCreateCodec (lx->listCodec, 1);
-				  for (i = 1; i < ms->share; i++)
-				    { OneCodec *m = ms[i].info[(int) t]->listCodec;
-				      ms[i].info[(int) t]->listCodec = lx->listCodec;
-				      vcDestroy (m);
-				    }
-				  lx->isUseListCodec = true;
-				  for (i = 1; i < ms->share; i++)
-				    ms[i].info[(int) t]->isUseListCodec = true;
+			  if (lx->listTack > ms->codecTrainingSize)
+			    { for (i = 1; i < ms->share; i++)
+				vcAddHistogram (lx->listCodec,
+						ms[i].info[(int) t]->listCodec);
+			      vcCreateCodec (lx->listCodec, 1);
+			      for (i = 1; i < ms->share; i++)
+				{ OneCodec *m = ms[i].info[(int) t]->listCodec;
+				  ms[i].info[(int) t]->listCodec = lx->listCodec;
+				  vcDestroy (m);
 				}
+			      lx->isUseListCodec = true;
+			      for (i = 1; i < ms->share; i++)
+				ms[i].info[(int) t]->isUseListCodec = true;
 			    }
-			  
-			  pthread_mutex_unlock(&ms->listLock);
 			}
+		      
+		      pthread_mutex_unlock(&ms->listLock);
 		    }
 		}
 	    }
@@ -2623,6 +4198,277 @@ void oneWriteComment (OneFile *vf, const char *format, ...)
   free (comment) ;
 }
 
+/***********************************************************************************
+ *
+ *    SORTING OBJECTS:
+ *      Objects are packed with their contained lines into an arena until it reaches the
+ *      memory limit, then sorted and written as a run, a temporary binary ONE file.  The
+ *      runs are merged with a heap, in passes of at most SORT_MERGE_MAX, into the output.
+ *      Within the arena each line is stored 8-byte aligned as a header word holding the
+ *      line type and comment length, the fields, the list, then the comment if there is one.
+ *
+ **********************************************************************************/
+
+#define SORT_KEY_MAX     4
+#define SORT_MERGE_MAX 256
+
+typedef struct {
+  I64 key[SORT_KEY_MAX] ;	// unused keys are 0
+  I64 off, len ;		// the object's lines in the arena - off also keeps the sort stable
+} SortItem ;
+
+typedef struct {
+  OneFile  *in, *out ;
+  char      type ;
+  int       nKey, *keyField ;
+  I64       maxBytes ;
+  char     *arena ;
+  I64       arenaSize, arenaUsed ;
+  SortItem *item ;
+  I64       itemSize, nItem ;
+  char    **run ;		// names of the run files
+  int       runSize, nRun ;
+} Sort ;
+
+static int sortItemOrder (const void *a, const void *b)
+{
+  const SortItem *x = (const SortItem*) a, *y = (const SortItem*) b ;
+  int k ;
+  for (k = 0 ; k < SORT_KEY_MAX ; ++k)
+    if (x->key[k] != y->key[k]) return (x->key[k] < y->key[k]) ? -1 : 1 ;
+  return (x->off < y->off) ? -1 : (x->off > y->off) ;
+}
+
+static I64 listBytes (OneInfo *li, I64 len, char *list)
+{
+  if (!li->listEltSize || len <= 0) return 0 ;
+  if (li->fieldType[li->listField] == oneSTRING_LIST)
+    { char *s = list ;
+      while (len--) s += strlen(s) + 1 ;
+      return s - list ;
+    }
+  return len * li->listEltSize ;
+}
+
+#define ALIGN8(n) (((n) + 7) & ~7)
+
+static void sortSaveLine (Sort *so) // append the current line of so->in to the arena
+{
+  OneFile *in = so->in ;
+  OneInfo *li = in->info[(int)in->lineType] ;
+  I64      len = li->listEltSize ? oneLen(in) : 0 ;
+  char    *list = len ? (char*) _oneList(in) : 0 ;
+  I64      nList = listBytes (li, len, list) ;
+  char    *comment = oneReadComment (in) ;
+  I64      nComment = comment ? strlen(comment) + 1 : 0 ;
+  I64      size = 8 + li->nField*sizeof(OneField) + ALIGN8(nList) + ALIGN8(nComment) ;
+
+  if (so->arenaUsed + size > so->arenaSize)
+    { I64 oldSize = so->arenaSize ;
+      so->arenaSize = 2*so->arenaSize + size ;
+      resize (so->arena, oldSize, so->arenaSize, char) ;
+    }
+  char *p = so->arena + so->arenaUsed ;
+  *(I64*)p = (nComment << 8) | (U8) in->lineType ; p += 8 ;
+  memcpy (p, in->field, li->nField*sizeof(OneField)) ; p += li->nField*sizeof(OneField) ;
+  if (nList) memcpy (p, list, nList) ;
+  p += ALIGN8(nList) ;
+  if (nComment) memcpy (p, comment, nComment) ;
+  so->arenaUsed += size ;
+}
+
+static char *sortWriteLine (OneFile *out, char *p) // write a line from the arena, return the next
+{
+  char     t = (char) (*(I64*)p & 0xff) ;
+  I64      nComment = *(I64*)p >> 8 ;
+  OneInfo *li = out->info[(int)t] ;
+  p += 8 ;
+  memcpy (out->field, p, li->nField*sizeof(OneField)) ; p += li->nField*sizeof(OneField) ;
+  I64 len = li->listEltSize ? (out->field[li->listField].len & 0xffffffffffffffll) : 0 ;
+  oneWriteLine (out, t, len, len ? p : 0) ; // NB may compact an INT_LIST in place - fine
+  p += ALIGN8(listBytes (li, len, p)) ;
+  if (nComment) oneWriteComment (out, "%s", p) ;
+  return p + ALIGN8(nComment) ;
+}
+
+static OneFile *sortRunCreate (Sort *so) // a new temporary binary file next to the output
+{
+  const char *prefix = strcmp (so->out->fileName, "-") ? so->out->fileName : "one" ;
+  char       *name = new (strlen(prefix) + 16, char) ;
+  sprintf (name, "%s.sortXXXXXX", prefix) ;
+  int fd = mkstemp (name) ;
+  if (fd == -1) die ("ONE sort error: cannot create temporary file %s", name) ;
+  close (fd) ;
+  OneFile *vf = oneFileOpenWriteFrom (name, so->in, true, 1) ;
+  if (!vf) die ("ONE sort error: cannot open temporary file %s", name) ;
+  if (so->nRun == so->runSize)
+    { int oldSize = so->runSize ;
+      so->runSize = 2*oldSize + 16 ;
+      resize (so->run, oldSize, so->runSize, char*) ;
+    }
+  so->run[so->nRun++] = name ;
+  return vf ;
+}
+
+static void sortFlush (Sort *so, OneFile *out) // sort the arena's objects and write them to out
+{
+  I64 i ;
+  qsort (so->item, so->nItem, sizeof(SortItem), sortItemOrder) ;
+  for (i = 0 ; i < so->nItem ; ++i)
+    { char *p = so->arena + so->item[i].off, *end = p + so->item[i].len ;
+      while (p < end) p = sortWriteLine (out, p) ;
+    }
+  so->nItem = 0 ;
+  so->arenaUsed = 0 ;
+}
+
+static OneFile *sortRunOpen (char *name) // open a run at its first object, and unlink it
+{
+  OneFile *vf = oneFileOpenRead (name, 0, 0, 1) ;
+  if (!vf) die ("ONE sort error: cannot reopen temporary file %s", name) ;
+  if (unlink (name) < 0) die ("ONE sort error: failed to unlink temporary file %s", name) ;
+  free (name) ;
+  oneReadLine (vf) ;
+  return vf ;
+}
+
+static inline bool sortRunLess (Sort *so, OneFile **run, int a, int b) // ties go to earlier runs
+{
+  int k ;
+  for (k = 0 ; k < so->nKey ; ++k)
+    { I64 x = oneInt(run[a], so->keyField[k]), y = oneInt(run[b], so->keyField[k]) ;
+      if (x != y) return x < y ;
+    }
+  return a < b ;
+}
+
+static void sortMerge (Sort *so, char **name, int n, OneFile *out) // merge n runs into out
+{
+  OneFile **run = new (n, OneFile*) ;
+  int      *heap = new (n, int) ;
+  int       i, nHeap = 0 ;
+
+  for (i = 0 ; i < n ; ++i)
+    { run[i] = sortRunOpen (name[i]) ;
+      if (run[i]->lineType == so->type) // sift up
+	{ int j = nHeap++ ;
+	  while (j && sortRunLess (so, run, i, heap[(j-1)/2])) { heap[j] = heap[(j-1)/2] ; j = (j-1)/2 ; }
+	  heap[j] = i ;
+	}
+    }
+  while (nHeap)
+    { OneFile *vf = run[heap[0]] ;
+      do oneWriteLineFrom (out, vf) ;
+      while (oneReadLine (vf) && vf->lineType != so->type) ;
+      int r = (vf->lineType == so->type) ? heap[0] : heap[--nHeap] ;
+      int j = 0, c ;
+      while ((c = 2*j+1) < nHeap) // sift down
+	{ if (c+1 < nHeap && sortRunLess (so, run, heap[c+1], heap[c])) ++c ;
+	  if (!sortRunLess (so, run, heap[c], r)) break ;
+	  heap[j] = heap[c] ; j = c ;
+	}
+      heap[j] = r ;
+    }
+  for (i = 0 ; i < n ; ++i) oneFileClose (run[i]) ;
+  free (run) ; free (heap) ;
+}
+
+bool oneSortObjects (OneFile *in, OneFile *out, char objectType, int nKey, int *keyField,
+		     I64 maxBytes)
+{
+  OneInfo *lt = in->info[(int)objectType] ;
+  int      k ;
+
+  if (in->isWrite || !out->isWrite || out->share)
+    { snprintf (errorString, 1024, "can only sort a file being read into an unthreaded file being written\n") ;
+      return false ;
+    }
+  if (!lt || !lt->isObject)
+    { snprintf (errorString, 1024, "%c is not an object type in %s\n", objectType, in->fileName) ;
+      return false ;
+    }
+  if (nKey < 1 || nKey > SORT_KEY_MAX)
+    { snprintf (errorString, 1024, "need between 1 and %d sort keys, not %d\n", SORT_KEY_MAX, nKey) ;
+      return false ;
+    }
+  for (k = 0 ; k < nKey ; ++k)
+    if (keyField[k] < 0 || keyField[k] >= lt->nField || lt->fieldType[keyField[k]] != oneINT)
+      { snprintf (errorString, 1024, "sort key field %d is not an INT field of %c\n",
+		  keyField[k], objectType) ;
+	return false ;
+      }
+
+  Sort so ;
+  memset (&so, 0, sizeof(Sort)) ;
+  so.in = in ; so.out = out ; so.type = objectType ; so.nKey = nKey ; so.keyField = keyField ;
+  so.maxBytes = (maxBytes > 0) ? maxBytes : (I64)1 << 30 ;
+
+  // lines outside objectType objects go straight to out, except groups of objectType, whose
+  //   boundaries would be meaningless after sorting - the sorted objects are written last
+
+  bool isInside = false ;
+  while (oneReadLine (in))
+    { char t = in->lineType ;
+      if (t == objectType)
+	{ if (so.nItem && so.arenaUsed + so.nItem*sizeof(SortItem) > so.maxBytes)
+	    { OneFile *vf = sortRunCreate (&so) ;
+	      sortFlush (&so, vf) ;
+	      oneFileClose (vf) ;
+	    }
+	  if (so.nItem == so.itemSize)
+	    { I64 oldSize = so.itemSize ;
+	      so.itemSize = 2*oldSize + 1024 ;
+	      resize (so.item, oldSize, so.itemSize, SortItem) ;
+	    }
+	  SortItem *it = &so.item[so.nItem++] ;
+	  memset (it->key, 0, sizeof(it->key)) ;
+	  for (k = 0 ; k < nKey ; ++k) it->key[k] = oneInt(in, keyField[k]) ;
+	  it->off = so.arenaUsed ;
+	  sortSaveLine (&so) ;
+	  it->len = so.arenaUsed - it->off ;
+	  isInside = true ;
+	}
+      else if (isInside && lt->contains[(int)t])
+	{ sortSaveLine (&so) ;
+	  so.item[so.nItem-1].len = so.arenaUsed - so.item[so.nItem-1].off ;
+	}
+      else
+	{ isInside = false ;
+	  if (!(in->info[(int)t]->isObject && in->info[(int)t]->contains[(int)objectType]))
+	    oneWriteLineFrom (out, in) ;
+	}
+    }
+
+  if (!so.nRun) // it all fitted in memory
+    sortFlush (&so, out) ;
+  else
+    { if (so.nItem)
+	{ OneFile *vf = sortRunCreate (&so) ;
+	  sortFlush (&so, vf) ;
+	  oneFileClose (vf) ;
+	}
+      free (so.arena) ; so.arena = 0 ;
+      while (so.nRun > SORT_MERGE_MAX) // merge groups of runs into new runs, keeping the order
+	{ char **old = so.run ;
+	  int    i, nOld = so.nRun ;
+	  so.run = 0 ; so.runSize = so.nRun = 0 ;
+	  for (i = 0 ; i < nOld ; i += SORT_MERGE_MAX)
+	    { int      n = (nOld - i < SORT_MERGE_MAX) ? nOld - i : SORT_MERGE_MAX ;
+	      OneFile *vf = sortRunCreate (&so) ;
+	      sortMerge (&so, old + i, n, vf) ;
+	      oneFileClose (vf) ;
+	    }
+	  free (old) ;
+	}
+      sortMerge (&so, so.run, so.nRun, out) ;
+    }
+
+  if (so.arena) free (so.arena) ;
+  if (so.item) free (so.item) ;
+  if (so.run) free (so.run) ;
+  return true ;
+}
+
 /***********************************************************************************
  *
  *    MERGING, FOOTER HANDLING, AND CLOSE
@@ -2642,6 +4488,14 @@ static void oneWriteFooter (OneFile *vf)
   //  first the per-linetype information
   codecBuf = new (vcMaxSerialSize()+1, char) ; // +1 for added up unused 0-terminator
   bool isWrittenIndexCodec = false ;
+  I64  maxZone = 0 ;
+  for (i = 'A' ; i <= 'z' ; ++i) // the reader needs the max zone map size to read them
+    if (vf->info[i] && vf->info[i]->zoneBlock > 0 && vf->info[i]->accum.count > 0)
+      { li = vf->info[i] ;
+	I64 nz = ((li->accum.count + li->zoneBlock-1) / li->zoneBlock) * 2*li->nField ;
+	if (nz > maxZone) maxZone = nz ;
+      }
+  if (maxZone) fprintf (vf->f, "@ * %lld\n", maxZone) ;
   for (k = 0; k < vf->nDefn ; ++k)
     { i  = vf->defnOrder[k] ;
       if (i & 0x80) continue ; // skip the 'G' lines
@@ -2653,6 +4507,11 @@ static void oneWriteFooter (OneFile *vf)
 	    { oneChar(vf,0) = (char) i ;
 	      oneWriteLine (vf, '&', li->accum.count+1, li->index) ;
 	    }
+	  if (li->zoneBlock > 0)
+	    { oneChar(vf,0) = (char) i ; oneInt(vf,1) = li->zoneBlock ;
+	      oneWriteLine (vf, '*', ((li->accum.count + li->zoneBlock-1) / li->zoneBlock)*2*li->nField,
+			    li->zone) ;
+	    }
 	  if (vf->info['&']->isUseListCodec && !isWrittenIndexCodec)
 	    { oneChar(vf,0) = '&' ;
               n = vcSerialize (vf->info['&']->listCodec, codecBuf);
@@ -2779,10 +4638,212 @@ void oneFinalizeCounts(OneFile *vf)
 		li->index[++n] = kIndex[j] + off;
 	      off += ftello(vf[k].f);
 	    }
+	  zoneMerge (vf, i, n0, nthreads) ;
 	}
     }
 }
 
+  // Append the whole of file in to out.  On Linux let the kernel do it with
+  //   copy_file_range(), which can share blocks on filesystems that support it (the thread
+  //   files are made next to the output), else sendfile(), else copy through a buffer.
+
+static void appendFile (FILE *in, FILE *out)
+{
+  struct stat st ;
+  off_t inOff = 0, outPos ;
+  int   fdIn = fileno (in), fdOut = fileno (out) ;
+
+  if (fflush (in) != 0 || fflush (out) != 0 || fstat (fdIn, &st) != 0)
+    die ("ONE write error: failed to flush thread file to append it") ;
+  outPos = ftello (out) ; // -1 if out is a pipe, which is fine
+
+#if defined(__linux__) && defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 27)
+  while (inOff < st.st_size)
+    { ssize_t n = copy_file_range (fdIn, &inOff, fdOut, 0, st.st_size - inOff, 0) ;
+      if (n <= 0) break ; // e.g. EXDEV or out is a pipe - inOff is only moved on success
+    }
+#endif
+#ifdef __linux__
+  while (inOff < st.st_size)
+    { ssize_t n = sendfile (fdOut, fdIn, &inOff, st.st_size - inOff) ;
+      if (n <= 0) break ;
+    }
+#endif
+  if (inOff < st.st_size)
+    { size_t bufSize = 1 << 23 ;
+      char  *buf = new (bufSize, char) ;
+      while (inOff < st.st_size)
+	{ ssize_t n = pread (fdIn, buf, bufSize, inOff), m = 0 ;
+	  if (n <= 0) die ("ONE write error: failed to read thread file to append it") ;
+	  while (m < n)
+	    { ssize_t k = write (fdOut, buf + m, n - m) ;
+	      if (k <= 0) die ("ONE write error: while appending thread file") ;
+	      m += k ;
+	    }
+	  inOff += n ;
+	}
+      free (buf) ;
+    }
+
+  if (outPos >= 0 && fseeko (out, outPos + st.st_size, SEEK_SET) != 0) // resync the stream
+    die ("ONE write error: failed to seek after appending thread file") ;
+}
+
+  // Copy bytes start to end of in, which is a binary file being read, on to the end of out.
+
+static void copyRange (OneFile *in, off_t start, off_t end, FILE *out)
+{
+  if (in->mapBase) // the whole file is mapped
+    { if (end > start && fwrite (in->mapBase + start, end - start, 1, out) != 1)
+	die ("ONE write error: failed to copy data from %s", in->fileName) ;
+      return ;
+    }
+
+  size_t bufSize = 1 << 23 ;
+  char  *buf = new (bufSize, char) ;
+  if (fseeko (in->f, start, SEEK_SET) != 0)
+    die ("ONE read error: failed to seek to data in %s", in->fileName) ;
+  while (start < end)
+    { size_t n = (end - start < (off_t) bufSize) ? end - start : bufSize ;
+      if (fread (buf, n, 1, in->f) != 1)
+	die ("ONE read error: failed to read data from %s", in->fileName) ;
+      if (fwrite (buf, n, 1, out) != 1)
+	die ("ONE write error: failed to copy data from %s", in->fileName) ;
+      start += n ;
+    }
+  free (buf) ;
+}
+
+static bool isSameCodec (OneCodec *a, OneCodec *b, char *buf) // buf is 2*vcMaxSerialSize()
+{
+  int n = vcSerialize (a, buf) ;
+  return vcSerialize (b, buf+n) == n && !memcmp (buf, buf+n, n) ;
+}
+
+bool oneFileCat (OneFile *vf, OneFile *in)
+{
+  int      i, k ;
+  I64      j, start = -1, nRead[128], tRead[128] ;
+  OneInfo *li, *lj ;
+
+  if (!vf->isWrite || vf->share || vf->isFinal || in->isWrite)
+    { snprintf (errorString, 1024, "can only append a file being read to an unthreaded file being written\n") ;
+      return false ;
+    }
+  for (i = 0 ; i < 128 ; ++i) // the data line types must match
+    if ((isalpha(i) || i == '/') && (lj = in->info[i]))
+      { li = vf->info[i] ;
+	if (!li || li->nField != lj->nField || li->isObject != lj->isObject
+	    || (li->nField && memcmp (li->fieldType, lj->fieldType, li->nField*sizeof(OneType))))
+	  { snprintf (errorString, 1024, "line type %c in %s does not match %s\n",
+		      i, in->fileName, vf->fileName) ;
+	    return false ;
+	  }
+      }
+
+  // we can copy the data blocks if both are binary and every codec used by in is one we can use
+
+  bool  isCopy = vf->isBinary && in->isBinary && (!in->isPacked || vf->isPackable) ;
+  char *buf = new (2*vcMaxSerialSize()+2, char) ;
+  for (i = 0 ; isCopy && i < 128 ; ++i)
+    if ((isalpha(i) || i == '/') && (lj = in->info[i]) && lj->listCodec
+	&& lj->listCodec != DNAcodec && vcHasCodec (lj->listCodec))
+      { li = vf->info[i] ;
+	if (li->isUseListCodec ? !isSameCodec (li->listCodec, lj->listCodec, buf) : !li->listCodec)
+	  isCopy = false ;
+      }
+  for (i = 0 ; isCopy && i < 128 ; ++i) // adopt in's codecs where vf has not yet trained one
+    if ((isalpha(i) || i == '/') && (lj = in->info[i]) && lj->listCodec
+	&& lj->listCodec != DNAcodec && vcHasCodec (lj->listCodec) && !vf->info[i]->isUseListCodec)
+      { li = vf->info[i] ;
+	vcSerialize (lj->listCodec, buf) ;
+	vcDestroy (li->listCodec) ;
+	li->listCodec = vcDeserialize (buf) ;
+	li->isUseListCodec = true ;
+      }
+  free (buf) ;
+
+  if (in->isBinary) // go to the start of the data
+    { for (i = 'A' ; i <= 'z' ; ++i)
+	if (in->info[i] && in->info[i]->index) break ;
+      if (i > 'z') isCopy = false ; // no index to find the start of the data
+      else if (!oneGoto (in, (char)i, 0))
+	{ snprintf (errorString, 1024, "failed to go to the start of the data in %s\n", in->fileName) ;
+	  return false ;
+	}
+    }
+
+  // re-encode lines until one starts an object that is not inside an object open in vf,
+  //   so that the counts for vf's open objects are right, then copy from there to the end
+
+  memset (nRead, 0, sizeof(nRead)) ;
+  memset (tRead, 0, sizeof(tRead)) ;
+  while (oneReadLine (in))
+    { char t = in->lineType ;
+      lj = in->info[(int)t] ;
+      if (isCopy && lj->isObject && lj->index && lj->accum.count > 0)
+	{ while (vf->objectFrame && !vf->openObjects[vf->objectFrame]->contains[(int)t])
+	    endObject (vf, vf->openObjects[vf->objectFrame]) ;
+	  if (!vf->objectFrame)
+	    { start = lj->index[lj->accum.count] ;
+	      break ;
+	    }
+	}
+      ++nRead[(int)t] ;
+      if (lj->listEltSize) tRead[(int)t] += oneLen(in) ;
+      oneWriteLineFrom (vf, in) ;
+    }
+  if (start < 0) return true ; // no block to copy - all re-encoded
+
+  binaryLineStart (vf) ;
+  if (in->isPacked) vf->isPacked = true ;
+  I64 byte0 = vf->byte ;
+  copyRange (in, start, in->footOff-1, vf->f) ; // footOff-1 is the end of data '\n'
+  vf->byte += in->footOff-1 - start ;
+  vf->isLastLineBinary = true ;
+
+  // add in's counts for the block, rebase its indexes, and fold in its zone maps and stats
+  
+  for (k = 0 ; k < in->nDefn ; ++k)
+    { i = in->defnOrder[k] ;
+      if (i & 0x80) continue ; // skip 'G' lines
+      lj = in->info[i] ;
+      li = vf->info[i] ;
+      I64 n0 = li->accum.count, nk = lj->given.count - nRead[i], j0 = nRead[i] ;
+      li->accum.count += nk ;
+      li->accum.total += lj->given.total - tRead[i] ;
+      if (lj->given.max > li->accum.max) li->accum.max = lj->given.max ;
+      if (!li->isObject || nk <= 0) continue ;
+
+      if (li->accum.count >= li->indexSize)
+	{ I64 oldSize = li->indexSize ;
+	  li->indexSize = li->accum.count + 1 ;
+	  resize (li->index, oldSize, li->indexSize, I64) ;
+	}
+      for (j = j0+1 ; j <= lj->given.count ; ++j)
+	li->index[++n0] = lj->index[j] - start + byte0 ;
+
+      if (li->zoneBlock >= 0 && lj->zoneBlock > 0)
+	{ if (!li->zoneBlock) li->zoneBlock = ZONE_BLOCK ;
+	  zoneFold (li, lj->zone, lj->zoneBlock, j0, lj->given.count, li->accum.count - lj->given.count) ;
+	}
+      else if (li->zoneBlock >= 0) // in has no zone map, e.g. from an older version, so drop ours
+	{ if (li->zone) free (li->zone) ;
+	  li->zone = 0 ; li->zoneSize = 0 ; li->zoneBlock = -1 ;
+	}
+
+      OneStat *s, *s1 ;
+      for (s = li->stats ; s->type ; ++s)
+	for (s1 = lj->stats ; s1 && s1->type ; ++s1)
+	  if (s1->type == s->type)
+	    { if (s1->maxCount > s->maxCount) s->maxCount = s1->maxCount ;
+	      if (s1->maxTotal > s->maxTotal) s->maxTotal = s1->maxTotal ;
+	    }
+    }
+
+  return true ;
+}
+
 //
 
 static void oneFinalize (OneFile *vf)
@@ -2793,17 +4854,9 @@ static void oneFinalize (OneFile *vf)
   if (!vf->isHeaderOut && (vf->isBinary || !vf->isNoAsciiHeader)) writeHeader (vf) ;
       
   if (vf->share > 0)
-    { int  i, nread ;
-      char *buf;
-      buf = new (10000000, char);
+    { int  i ;
       for (i = 1; i < vf->share; i++)
-	{ if (fseek (vf[i].f, 0L, SEEK_SET) != 0)
-	    die ("ONEfile error: failed to rewind parallel file %d", i) ;
-	  while (!feof(vf[i].f) && (nread = fread (buf,1,10000000,vf[i].f)) > 0)
-	    if ((int) fwrite(buf,1,nread,vf->f) != nread)
-	      die ("ONE write error: while cat'ing thread bits (oneFileClose)");
-	}
-      free(buf);
+	appendFile (vf[i].f, vf->f) ;
     }
 
   if (vf->isBinary || vf->line)
@@ -2813,12 +4866,26 @@ static void oneFinalize (OneFile *vf)
 	fputc ('\n', vf->f);  // need an extra '\n' to ensure end of data marker
       oneWriteFooter (vf);
     }
+
+  if (vf->share > 0)
+    { int  i ;
+      for (i = 1; i < vf->share; i++)
+	if (vf[i].isPacked) vf->isPacked = true ;
+    }
+  if (vf->isPacked) // mark the header so that code that can't unpack lists rejects the file
+    { off_t end = ftello (vf->f) ;
+      if (fseeko (vf->f, vf->minorPos, SEEK_SET) || fputc ('0' + MINOR, vf->f) == EOF
+	  || fseeko (vf->f, end, SEEK_SET))
+	die ("ONE write error: failed to set the minor version in the header of %s", vf->fileName) ;
+    }
 }
 
 void oneFileClose (OneFile *vf)
 {
   assert (vf->share >= 0) ;
 
+  if (vf->isCursor) { oneCursorDestroy (vf) ; return ; }
+
   if (vf->isWrite)
     oneFinalize (vf) ;
   
@@ -2888,6 +4955,7 @@ typedef unsigned short      uint16;
 typedef unsigned char       uint8;
 
 #define HUFF_CUTOFF  12     //  This cannot be larger than 16 !
+#define MULTI_BITS   12     //  Index bits of the multi-symbol decoding table
 
   //  Endian flipping macros
 
@@ -2932,12 +5000,19 @@ typedef unsigned char       uint8;
 #define CODED_WITH   2      //  Compressor has a codec (can no longer accumulate histogram)
 #define CODED_READ   3      //  Compressor has codec but no histogram as was created by read
 
+typedef struct
+  { uint8  nsym;             //  Number of whole codes in the index bits, 0 if the first
+    uint8  nbits;            //    is an escape or too long, and their total length
+    uint8  sym[6];           //  The decoded symbols
+  } _MultiCode;
+
 typedef struct
   { int    state;            //  1 of the 4 states immediately above
     int    isbig;            //  endian of the current machine
     uint16 codebits[256];    //  Code esc_code is the special code for
     uint8  codelens[256];    //    non-Huffman exceptions
     char   lookup[0x10000];  //  Lookup table (just for decoding)
+    _MultiCode multi[1 << MULTI_BITS];  //  Multi-symbol lookup table (just for decoding)
     int    esc_code;         //  The special escape code (-1 if not partial)
     int    esc_len;          //  The length in bits of the special code (if present)
     uint64 hist[256];        //  Byte distribution for codec
@@ -3024,6 +5099,29 @@ int HSORT(const void *l, const void *r)
   return (HIST[x] - HIST[y]);
 }
 
+  //  Fill the multi-symbol decoding table from the lookup table: entry x gives all the
+  //    codes (up to 6) that fit entirely within the MULTI_BITS bits x, stopping at an escape.
+  //    Must be called with lens[esc_code] already set to 0.
+
+static void vcMakeMulti(_OneCodec *v)
+{ int x, pos, c;
+
+  for (x = 0; x < (1 << MULTI_BITS); x++)
+    { _MultiCode *m = v->multi + x;
+
+      m->nsym = m->nbits = 0;
+      pos = 0;
+      while (m->nsym < 6)
+        { c = (uint8) v->lookup[((x << pos) << (16-MULTI_BITS)) & 0xffff];
+          if (c == v->esc_code || v->codelens[c] == 0 || pos + v->codelens[c] > MULTI_BITS)
+            break;
+          m->sym[m->nsym++] = c;
+          pos += v->codelens[c];
+        }
+      m->nbits = pos;
+    }
+}
+
 void vcCreateCodec(OneCodec *vc, int partial)
 { _OneCodec *v = (_OneCodec *) vc;
 
@@ -3215,6 +5313,7 @@ void vcCreateCodec(OneCodec *vc, int partial)
     }
   else
     v->esc_code = -1;
+  vcMakeMulti(v);
   v->state = CODED_WITH;
 }
 
@@ -3308,6 +5407,11 @@ void vcPrint(OneCodec *vc, FILE *to)
 int vcMaxSerialSize()
 { return (257 + 2*sizeof(int) + 256*sizeof(uint16)); }
 
+  //  True if vc has a codec, i.e. can be serialized
+
+bool vcHasCodec(OneCodec *vc)
+{ return (((_OneCodec *) vc)->state >= CODED_WITH); }
+
   //  Code the compressor into blob 'out' and return number of bytes in the code
 
 int vcSerialize(OneCodec *vc, void *out)
@@ -3421,6 +5525,7 @@ OneCodec *vcDeserialize(void *in)
     }
   if (v->esc_code >= 0)
     lens[v->esc_code] = 0;
+  vcMakeMulti(v);
 
   return ((OneCodec *) v);
 }
@@ -3432,60 +5537,13 @@ OneCodec *vcDeserialize(void *in)
  *
  ********************************************************************************************/
 
-static uint8 Number[128] =
-    { 0, 1, 2, 3, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 1, 0, 0, 0, 2,
-      0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 3, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 1, 0, 0, 0, 2,
-      0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 3, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0,
-    };
-
   //  Compress DNA into 2-bits per base
-  //  Richard switched to little-endian December 2022 - big-endian remains in comments
-  //  should detect endianness and check and/or switch
+  //  Richard switched to little-endian December 2022: first base in the low 2 bits
+  //  The packing kernels are shared with seqio in dnapack.h (SIMD on x86_64)
 
 I64 Compress_DNA(I64 len, char *s, char *t)
-{ I64    i, j;
-  uint8 *s0, *s1, *s2, *s3;
-
-  s0 = (uint8 *) s;
-  s1 = s0+1;
-  s2 = s1+1;
-  s3 = s2+1;
-
-  len -= 3;
-  for (i = j = 0; i < len; i += 4)
-    t[j++] = Number[s0[i]] | (Number[s1[i]] << 2) | (Number[s2[i]] << 4) | (Number[s3[i]] << 6) ;
-      // (Number[s0[i]] << 6) | (Number[s1[i]] << 4) | (Number[s2[i]] << 2) | Number[s3[i]];
-  switch (i-len)
-  { case 0:
-      t[j++] = Number[s0[i]] | (Number[s1[i]] << 2) | (Number[s2[i]] << 4) ;
-	// (Number[s0[i]] << 6) | (Number[s1[i]] << 4) | (Number[s2[i]] << 2);
-      break;
-    case 1:
-      t[j++] = Number[s0[i]] | (Number[s1[i]] << 2) ;
-        // (Number[s0[i]] << 6) | (Number[s1[i]] << 4);
-      break;
-    case 2:
-      t[j++] = Number[s0[i]] ;
-        // (Number[s0[i]] << 6);
-      break;
-    default:
-      break;
-  }
-
-  return ((len+3)<<1);
+{ dnaPack2bit(s, (uint8 *) t, len);
+  return (len<<1);
 }
 
   //  Encode ibytes[0..ilen) according to compressor vc and place in obytes
@@ -3586,65 +5644,47 @@ I64 vcEncode(OneCodec *vc, I64 ilen, char *ibytes, char *obytes)
   return (tbits);
 }
 
-  //  Uncompress read from 2-bits per base into [0-3] per byte representation
-
-static char Base[4] = { 'a', 'c', 'g', 't' };
+  //  Uncompress read from 2-bits per base into acgt
 
 I64 Uncompress_DNA(char *s, I64 len, char *t)
-{ I64   i, tlen;
-  int   byte;
-  char *t0, *t1, *t2, *t3;
-
-  t0 = t;
-  t1 = t0+1;
-  t2 = t1+1;
-  t3 = t2+1;
-
-  tlen = len-3;
-  for (i = 0; i < tlen; i += 4)
-    { byte = *s++;
-      t0[i] = Base[byte & 0x3];        // Base[(byte >> 6) & 0x3];
-      t1[i] = Base[(byte >> 2) & 0x3]; // Base[(byte >> 4) & 0x3];
-      t2[i] = Base[(byte >> 4) & 0x3]; // Base[(byte >> 2) & 0x3];
-      t3[i] = Base[(byte >> 6) & 0x3]; // Base[byte & 0x3];
-    }
-
-  switch (i-tlen)
-  { case 0:
-      byte = *s++;
-      t0[i] = Base[byte & 0x3];        // Base[(byte >> 6) & 0x3];
-      t1[i] = Base[(byte >> 2) & 0x3]; // Base[(byte >> 4) & 0x3];
-      t2[i] = Base[(byte >> 4) & 0x3]; // Base[(byte >> 2) & 0x3];
-      break;
-    case 1:
-      byte = *s++;
-      t0[i] = Base[byte & 0x3];        // Base[(byte >> 6) & 0x3];
-      t1[i] = Base[(byte >> 2) & 0x3]; // Base[(byte >> 4) & 0x3];
-      break;
-    case 2:
-      byte = *s++;
-      t0[i] = Base[byte & 0x3];        // Base[(byte >> 6) & 0x3];
-      break;
-    default:
-      break;
-  }
-
+{ dnaUnpack2bit((uint8 *) s, t, len, "acgt");
   return (len);
 }
 
+  //  The i'th 64-bit word of the coded bit stream of nw full words followed by a tail.
+  //    w0 and tail are prepared by vcDecode since they are stored specially.
+
+static inline uint64 vcWord(uint8 *in, I64 i, I64 nw, uint64 w0, uint64 tail, int flip)
+{ uint64 w;
+  uint8 *b = (uint8 *) &w;
+
+  if (i == 0)
+    return (w0);
+  if (i < nw)
+    { memcpy(b,in+(i<<3),8);
+      if (flip)
+        FLIP64(b)
+      return (w);
+    }
+  if (i == nw)
+    return (tail);
+  return (0);
+}
+
   //  Decode ilen bits in ibytes, into obytes according to vc's codec
-  //  Return the number of bytes decoded.
+  //  Return the number of bytes decoded.  Up to 6 codes are decoded at a time by looking
+  //    up the next MULTI_BITS bits in v->multi, falling back to one code at a time with the
+  //    16-bit v->lookup for long codes and escapes.  ibytes is not changed.
 
 I64 vcDecode(OneCodec *vc, I64 ilen, char *ibytes, char *obytes)
 { _OneCodec *v = (_OneCodec *) vc;
 
-  char   *look;
-  uint8  *lens, *q;
-  uint64  icode, ncode, *p;
-  int     rem, nem;
-  uint8   c, *o;
-  I64     k;
-  int     n, elen, inbig, esc;
+  char       *look;
+  _MultiCode *multi, *m;
+  uint8      *lens, *in, *o, c;
+  uint64      w0, tail, wa, wb, win;
+  I64         nw, pos, jw, j, k;
+  int         s, inbig, flip, esc, elen;
 
   if (vc == DNAcodec)
     return (Uncompress_DNA(ibytes,ilen>>1,obytes));
@@ -3657,87 +5697,79 @@ I64 vcDecode(OneCodec *vc, I64 ilen, char *ibytes, char *obytes)
       return (olen);
     }
 
-  p = (uint64 *) ibytes;
-
-  inbig = (*ibytes & 0x40);
-  if (!inbig && ilen >= 64)
-    { uint8 x = ibytes[7];
-      ibytes[7] = ibytes[0];
-      ibytes[0] = x;
-    }
-
-  if (inbig != v->isbig)
-    { q = (uint8 *) ibytes;
-      for (k = 64; k <= ilen; k += 64)
-        { FLIP64(q)
-          q += 8;
+  //  The stream is nw full words in the writer's byte order, the first with bytes 0 and 7
+  //    swapped if the writer was little-endian so that the first byte carries the endian
+  //    flag, followed by the remaining bits as bytes most significant first.
+
+  in    = (uint8 *) ibytes;
+  inbig = (*in & 0x40);
+  flip  = ((inbig != 0) != (v->isbig != 0));
+  nw    = (ilen >> 6);
+
+  tail = 0;
+  for (k = 0; (nw << 6) + k < ilen; k += 8)
+    tail |= (((uint64) in[(nw<<3) + (k>>3)]) << (56-k));
+  if (nw > 0)
+    { uint8 *b = (uint8 *) &w0;
+      memcpy(b,in,8);
+      if (!inbig)
+        { uint8 x = b[7];
+          b[7] = b[0];
+          b[0] = x;
         }
-    }
-
-  lens = v->codelens;
-  look = v->lookup;
-  esc  = v->esc_code;
-  elen = v->esc_len;
-
-#define GET(n)						\
-  ilen  -= n;						\
-  icode <<= n;						\
-  rem   -= n;						\
-  while (rem < 16)					\
-    { int z = 64-rem;					\
-      icode |= (ncode >> rem);				\
-      if (nem > z)					\
-        { nem -= z;					\
-          ncode <<= z;					\
-          rem = 64;					\
-          break;					\
-        }						\
-      else						\
-        { rem += nem; 					\
-          if (rem >= ilen)				\
-            break;					\
-          else if (ilen-rem < 64)			\
-            { nem = ilen-rem;				\
-              q = (uint8 *) p;				\
-              ncode = 0;				\
-              for (k = 0; k < nem; k += 8)		\
-                ncode |= (((uint64) (*q++)) << (56-k));	\
-            }						\
-          else						\
-            { ncode = *p++;				\
-              nem   = 64;				\
-            }						\
-	}						\
-    }
- 
-  if (ilen < 64)
-    { q = (uint8 *) ibytes;
-      icode = 0;
-      for (k = 0; k < ilen; k += 8)
-        icode |= (((uint64) (*q++)) << (56-k));
+      if (flip)
+        FLIP64(b)
     }
   else
-    icode = *p++;
-  o = (uint8 *) obytes;
-  icode <<= 2;
-  ilen -= 2;
-  rem   = 62;
-  if (rem > ilen)
-    rem = ilen;
-  ncode = 0;
-  nem   = 0;
-  while (ilen > 0)
-    { c = look[icode >> 48];
-      if (c == esc)
-        { GET(elen)
-          c = (icode >> 56);
-          GET(8);
+    w0 = tail;
+
+  lens  = v->codelens;
+  look  = v->lookup;
+  multi = v->multi;
+  esc   = v->esc_code;
+  elen  = v->esc_len;
+
+#define PEEK(p)						\
+  { j = (p) >> 6;					\
+    if (j != jw)					\
+      { if (j == jw+1)					\
+          wa = wb;					\
+        else						\
+          wa = vcWord(in,j,nw,w0,tail,flip);		\
+        wb = vcWord(in,j+1,nw,w0,tail,flip);		\
+        jw = j;						\
+      }							\
+    s   = (p) & 0x3f;					\
+    win = s ? ((wa << s) | (wb >> (64-s))) : wa;	\
+  }
+
+  o   = (uint8 *) obytes;
+  jw  = 0;
+  wa  = w0;
+  wb  = vcWord(in,1,nw,w0,tail,flip);
+  pos = 2;                 //  skip the two flag bits
+  while (pos < ilen)
+    { PEEK(pos)
+      m = multi + (win >> (64-MULTI_BITS));
+      if (m->nsym > 0 && pos + m->nbits <= ilen)
+        { for (k = 0; k < m->nsym; k++)
+            *o++ = m->sym[k];
+          pos += m->nbits;
         }
       else
-        { n = lens[(int) c];
-          GET(n)
+        { c = look[win >> 48];
+          if (c == esc)
+            { pos += elen;
+              PEEK(pos)
+              c = (win >> 56);
+              pos += 8;
+            }
+          else if (lens[c] == 0)
+            die("vcDecode: no code for bit pattern %04x", (int) (win >> 48));
+          else
+            pos += lens[c];
+          *o++ = c;
         }
-      *o++ = c;
     }
 
   return (o - (uint8 *) obytes);
@@ -3824,7 +5856,7 @@ static inline I64 ltfRead (FILE *f)
   unsigned char u[16] ;
   I64 val = 0 ;
 
-  u[0] = getc (f) ;
+  u[0] = getc_unlocked (f) ;
   if (u[0] & 0x40)
     { if (u[0] & 0x80) // negative
 	val = (char) u[0] ;
@@ -3835,7 +5867,7 @@ static inline I64 ltfRead (FILE *f)
     //   printf ("read %d n 1 u %02x\n", (int)val, u[0]) ;
     // }
   else if (u[0] & 0x20)
-    { u[1] = getc (f) ; intGet (u, &val) ;
+    { u[1] = getc_unlocked (f) ; intGet (u, &val) ;
       //      printf ("read %d n 2 u %02x %02x\n", (int)val, u[0], u[1]) ;
     }
   else
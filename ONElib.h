@@ -79,6 +79,16 @@ typedef struct
     bool isList ;
   } OneStat ;
 
+typedef struct
+  { I64  lines ;                   // lines read
+    I64  bytes ;                   // bytes taken by these lines in the file
+    I64  rawBytes ;                // bytes of their fields and lists once decoded
+    I64  nDecode, decodeNs ;       // list codec decodes, and time spent in them
+    I64  nDecompact ;              // decompactIntList() calls for byte-compacted INT_LISTs
+    I64  nUnpack ;                 // bit-packed INT_LISTs unpacked
+    I64  readNs ;                  // time spent in oneReadLine() for these lines
+  } OneIOStat ;                    // only collected if ONElib.c is compiled with -DONE_STATS
+
   // OneCodecs are a private package for binary one file compression
 
 typedef void OneCodec; // forward declaration of opaque type for compression codecs
@@ -96,12 +106,16 @@ typedef struct
   { bool      isObject;         // set if this is an object type (O in schema)
     I64      *index;            // index for objects
     I64       indexSize;        // size of the index, if present
+    I64      *zone;             // zone map: min,max of each field for each block of objects
+    I64       zoneSize;         // size of the zone map, if present
+    I64       zoneBlock;        // number of objects per zone map block, -1 if no INT fields
     bool      contains[128];    // contains[k] is true if linetype k contained in this object
     OneStat  *stats;            // 0-terminated list of stats for all contained types within the object
     bool      isFirst;          // if set then set count0 for any objects closed by this linetype
     bool      isClosed;         // set if has been closed in this file
     OneCounts accum;            // counts read or written to this moment
     OneCounts given;            // counts read from header
+    OneIOStat io;               // read counters, see oneReportStats()
 
     int       nField;           // number of fields
     OneType  *fieldType;        // type of each field
@@ -109,6 +123,7 @@ typedef struct
     int       listField;        // field index of list
     
     bool      isUserBuf;        // flag for whether buffer is owned by user
+    bool      isSkipList;       // if set then binary reading skips the list without decoding
     I64       bufSize;          // system buffer and size if not user supplied
     void     *buffer;
 
@@ -196,6 +211,19 @@ typedef struct
     pthread_mutex_t fieldLock;     // Mutexs to protect training accumumulation stats when threaded
     pthread_mutex_t listLock;
     FILE* *tempReadFiles;          // array of file pointers to be used by oneFileReopen()
+    char  *mapBase;                // start and end of memory mapped binary file, if mapped
+    char  *mapEnd;
+    char  *mapPos;                 // current read position in the mapping, 0 if not mapped
+    void  *mapList;                // if non-zero, list of current line is here in the mapping
+    char  *mapCodec;               // if non-zero, compressed list of current line is here
+    void  *prefetch;               // read-ahead helper thread state, if running
+    bool   isCursor;               // made by oneCursorCreate() - shares most state with its file
+    I64    packBufSize;            // buffer for bit-packed INT_LISTs when writing
+    U8    *packBuf;
+    bool   isPackable;             // INT_LISTs may be bit-packed: binary and seekable when writing
+    bool   isPacked;               // some INT_LIST is bit-packed, so the header minor is MINOR
+    I64    minorPos;               // where the minor version is in the header when writing
+    I64    footOff;                // start of the footer of a binary file being read
   } OneFile;                       // the footer will be in the concatenated result.
 
 
@@ -237,13 +265,15 @@ OneSchema *oneSchemaCreateFromText (const char *text) ;
   //      D Q 1 6 STRING                     the phred encoded quality score + ASCII 33
   //      D N 4 4 REAL 4 REAL 4 REAL 4 REAL  signal to noise ratio in A, C, G, T channels
   //      G g 2 3 INT 6 STRING               group designator: number of objects, name
-  // The ...FromText() alternative writes the text to a temp file and reads it with 
-  //   oneSchemaCreateFromFile(). This allows code to set the schema.
+  // The ...FromText() alternative parses the text in memory, with no temporary file, and
+  //   caches the result, so repeated calls with the same text are cheap.  This allows code
+  //   to set the schema.
   // Internally a schema is a linked list of OneSchema objects, with the first holding
   //   the (hard-coded) schema for the header and footer, and the remainder each 
   //   corresponding to one primary file type.
 
 void oneSchemaDestroy (OneSchema *schema) ;
+void oneSchemaCacheClear (void) ; // frees the cache of schemas made from text
 
 bool oneFileWriteSchema (OneFile *of, char *filename) ;
 
@@ -269,6 +299,20 @@ OneFile *oneFileOpenRead (const char *path, OneSchema *schema, const char *type,
   //   slave or master in a parallel group.  The master recieves provenance, counts, etc.
   //   The slaves only read data and have the virtue of sharing indices and codecs with
   //   the master if relevant.
+  // Binary files (other than stdin) are memory mapped if possible, and data lines are then
+  //   decoded directly from the mapping rather than through stdio - see _oneList() below.
+  // Gzipped files (other than stdin) are decompressed transparently.  If they are block
+  //   gzipped (BGZF, e.g. by bgzip) then blocks are inflated ahead of the reader by a pool
+  //   of threads and seeking uses the block offset table, so oneGoto() still works.
+
+bool oneFilePrefetch (OneFile *of, I64 window) ;
+
+  // Starts a helper thread that keeps the next 'window' bytes of the file in memory ahead
+  //   of reading, for binary and ascii files, so I/O overlaps with processing, e.g. on
+  //   network filesystems.  window = 0 stops it.  Returns false if not possible, e.g. on
+  //   stdin or a slave.  It follows the master's read position, so suits sequential reading.
+  // Setting the environment variable ONE_PREFETCH=<Mbytes> starts this on every file
+  //   opened by oneFileOpenRead(), so tools get it without changing them.
 
 bool oneFileCheckSchema (OneFile *of, OneSchema *schema, bool isRequired) ;
 bool oneFileCheckSchemaText (OneFile *of, const char *textSchema) ;
@@ -316,6 +360,10 @@ void   *_oneCompressedList (OneFile *of) ;      // lazy codec compression if req
   //         { // do something with i'th string
   //           s = oneNextString(of,s);
   //         }
+  //   When reading a memory mapped binary file, uncompressed DNA and REAL_LIST lists are
+  //   returned as pointers into the mapping rather than copied into ->buffer (unless a user
+  //   buffer has been set).  These stay valid until the file is closed, and the mapping is
+  //   private, so writing into them is safe and does not change the file.
 
 char *oneReadComment (OneFile *of);
 
@@ -371,6 +419,20 @@ bool oneAddDeferred   (OneFile *of, const char *filename);
   //   create and fill the relevant OneCounts objects before the first call to oneWriteLine.
   //   For BINARY output, the OneCounts information is accumulated and written automatically.
 
+bool oneCodecsWrite (OneFile *of, const char *fileName) ;
+bool oneCodecsLoad  (OneFile *of, const char *fileName) ;
+
+  // Binary files train a list compression codec per line type once they have seen enough
+  //   data, so small files compress poorly.  oneCodecsWrite() saves the trained codecs of
+  //   of, e.g. a large representative file after reading it, to a small binary ONE file of
+  //   type codec.  oneCodecsLoad() installs them in a binary file opened for writing, before
+  //   the first oneWriteLine(), so that lists are compressed from the start without training,
+  //   and adds fileName to the references in the header.  The codecs used are still written
+  //   in the footer, so reading does not need fileName.  Returns false if fileName can't be
+  //   read, has no codecs, or was made for a different primary file type.
+  // Setting the environment variable ONE_CODECS=<fileName> calls oneCodecsLoad() in
+  //   oneFileOpenWrite*() for every binary file of the matching type.
+
 void oneWriteLine (OneFile *of, char lineType, I64 listLen, void *listBuf);
 
   // Set up a line for output just as it would be returned by oneReadLine and then call
@@ -395,6 +457,29 @@ static inline void oneWriteLineFrom (OneFile *of, OneFile *source)
 }
   // utility to transfer a line from source through to ref without the local code knowing the schema
 
+bool oneFileCat (OneFile *of, OneFile *in) ;
+
+  // Appends all the data of in, opened for reading, to of, which must have the same line types
+  //   and not be threaded.  If both are binary, the data of in is copied as a block, with its
+  //   indexes rebased and its counts, zone maps and object stats added in, unless in used a
+  //   codec that differs from one of is already using, when it is re-encoded line by line as
+  //   for ascii.  of adopts in's codecs if it has not trained its own yet, so catting files
+  //   written with the same codecs, e.g. via oneCodecsLoad(), is a copy at disk speed.  The
+  //   provenance, references and header text of in are not transferred.  Returns false on
+  //   failure - see oneErrorString().
+
+bool oneSortObjects (OneFile *in, OneFile *out, char objectType, int nKey, int *keyField,
+		     I64 maxBytes) ;
+
+  // Reads in from its current line to the end and writes it to out with the objectType objects,
+  //   each with its contained lines, in order of up to 4 INT fields of the object line, given
+  //   by keyField[0..nKey-1], keeping the input order for equal keys.  e.g. for .1aln files
+  //   {0,1} sorts A objects by (aread,abpos), {3,0,4} by (bread,aread,bbpos).  Lines outside
+  //   objectType objects are written first, except for groups of objectType objects, which
+  //   are dropped.  At most about maxBytes (1GB if 0) of objects are held in memory: beyond
+  //   that sorted runs are written to temporary binary files next to out, then merged.
+  //   out must not be threaded.  Returns false on failure - see oneErrorString().
+
 // CLOSING FILES (FOR BOTH READ & WRITE):
 
 void oneFileClose (OneFile *of);
@@ -402,6 +487,11 @@ void oneFileClose (OneFile *of);
   // Close of (opened either for reading or writing). Finalizes counts, merges theaded files,
   // and writes footer if binary. Frees all non-user memory associated with of.
 
+void oneFinalizeCounts (OneFile *of);
+
+  // Complete the counts and object stats of of, opened for writing, as oneFileClose() does
+  // first.  Only needed to look at them before closing, e.g. with oneStatsContains().
+
 //  FILE INFORMATION, GOTO & BUFFER MANAGEMENT:
 
 #define oneFileName(of) ((of)->fileName)
@@ -416,6 +506,14 @@ bool  oneStatsContains (OneFile *of, char objectType, char lineType, I64 *maxCou
 
   // Report the largest count of lineType within an objectType, and the highest total list length.
 
+bool  oneReportStats (OneFile *of, FILE *f) ;
+
+  // Writes a table of the I/O and codec counters in OneInfo->io for each line type read so
+  //   far, summed over threads for a master: bytes in the file against decoded bytes, codec
+  //   decode time, INT_LIST decompactions and time in oneReadLine().  Time spent outside
+  //   oneReadLine() and oneList() is the caller's own.  The counters are only collected if
+  //   ONElib.c is compiled with -DONE_STATS - otherwise this says so and returns false.
+
 #define oneObject(of,i)  ((of) && (of)->info[i] ? (of)->info[i]->accum.count : -1)
 
   // Returns the number of the object of type lineType currently in.  Works in read
@@ -436,6 +534,98 @@ I64 oneCountUntilNext (OneFile *of, char countType, char nextType) ;
   // group object, although the semantics do not precisely match those of oneStatsContains().
   // Returns -1 on error, e.g. not reading a binary file, types are not object types.
 
+typedef void *OneScanFunc (OneFile *of, I64 iStart, I64 iEnd, void *arg) ;
+
+void **oneParallelScan (OneFile *of, char objectType, OneScanFunc *func, void *arg) ;
+
+  // Splits the objects of objectType into one range per thread OneFile, balanced by size
+  //   in bytes using the index, and calls func() on each range in its own thread, using the
+  //   nthreads given to oneFileOpenRead().  Each call is given a thread's OneFile positioned
+  //   with the first line of object iStart already read, and should process objects
+  //   iStart to iEnd-1, e.g.
+  //       while (of->lineType && oneObject(of,objectType) < iEnd)
+  //         { ... ; oneReadLine (of) ; }
+  //   Returns an array of the nthreads return values of func() in range order, which the
+  //   caller must free(), or NULL if of is not a binary file with an index for objectType.
+  //   func() must be threadsafe with respect to arg; ranges can be empty and then func()
+  //   is not called.
+
+OneFile *oneCursorCreate (OneFile *of) ;
+void     oneCursorDestroy (OneFile *cursor) ;
+
+  // A cursor is a cheap private reader of a binary file of opened for reading, that can be
+  //   made and destroyed at any time, e.g. by each task of a thread pool, as an alternative
+  //   to choosing nthreads in oneFileOpenRead().  It shares the schema, codecs, index and
+  //   zone map of of, and its memory mapping, so needs no file handle of its own unless the
+  //   file could not be mapped.  It has its own position, starting at the start of the data,
+  //   its own fields and list buffers, and counts.  Use it like of, e.g.
+  //       OneFile *c = oneCursorCreate (of) ;
+  //       oneGoto (c, 'A', i) ; while (oneReadLine (c) && ...) { ... oneInt(c,0) ... }
+  //       oneCursorDestroy (c) ;
+  //   Creating and using cursors is threadsafe provided of is not closed meanwhile, and
+  //   no-one calls oneUserBuffer() or oneSkipList() on of.  Cursors copy of's list skipping
+  //   settings when made.  Returns NULL if of is not a binary master file open for reading.
+
+typedef struct
+  { char  lineType ;  // objectType itself, or a line type found within the object
+    int   field ;     // field number, or -1 to count the lineType lines in the object
+    void *data ;      // caller's column array: double for REAL, char for CHAR, else I64
+  } OneColumn ;
+
+I64 oneReadBatch (OneFile *of, char objectType, I64 n, int nCol, OneColumn *col) ;
+
+  // Decodes up to n objects of objectType into the columns col[0..nCol-1], starting with
+  //   the current line, which must be an objectType line, and returns the number decoded.
+  //   Entry k of each column holds the value for the k'th object, or 0 if there is no such
+  //   line in the object (if several, the last is used).  For a list field the value is the
+  //   list length.  Lists are skipped without being decoded.  Afterwards of is left on the
+  //   next objectType line, or at the end of the data, so that oneReadBatch() can be called
+  //   again.  e.g. for .1aln files, to get abpos, aepos, and whether there is an R line:
+  //       OneColumn col[3] = {{'A',1,abpos},{'A',2,aepos},{'R',-1,isR}} ;
+  //       nA = oneReadBatch (of, 'A', nMax, 3, col) ;
+
+typedef struct OneRangeIndexStruct OneRangeIndex ;
+
+bool oneRangeIndexWrite (OneFile *of, const char *indexFileName, char objectType,
+			 int nKey, int *keyField) ;
+
+  // Reads of from its current line to the end, and writes a binary interval index of the
+  //   objectType objects into indexFileName, by convention <file>.1rix.  There are nKey keys,
+  //   each given by three INT fields of the objectType line in keyField[3*k .. 3*k+2]: an id,
+  //   which must be >= 0, e.g. a sequence number, and start and end coordinates on it.  e.g.
+  //   for .1aln files {0,1,2, 3,4,5} indexes A objects by (aread,abpos,aepos) as key 0 and
+  //   by (bread,bbpos,bepos) as key 1.  Returns false on failure - see oneErrorString().
+
+OneRangeIndex *oneRangeIndexRead (const char *indexFileName, OneFile *of) ;
+void oneRangeIndexDestroy (OneRangeIndex *rx) ;
+char oneRangeIndexType (OneRangeIndex *rx) ;
+
+  // Opens an index made by oneRangeIndexWrite().  If of is a binary file, checks that its
+  //   count of the indexed object type matches the index, returning NULL if not, e.g. if stale.
+  //   oneRangeIndexType() gives the object type that was indexed.
+
+I64 oneRangeQuery (OneRangeIndex *rx, int key, I64 id, I64 start, I64 end, I64 **objects) ;
+
+  // Finds the objects whose interval for key on id overlaps [start,end), i.e. with
+  //   istart < end and iend > start, and returns how many, with their object numbers in
+  //   increasing order in *objects, ready for oneGoto().  *objects is owned by rx and is
+  //   overwritten by the next query.  Only the intervals on id are read from the index, and
+  //   they are kept, so further queries on the same id take O(log n + hits).
+
+I64  oneZoneBlocks (OneFile *of, char objectType, I64 *blockSize) ;
+bool oneZoneRange (OneFile *of, char objectType, I64 block, int field, I64 *min, I64 *max) ;
+
+  // Binary files carry a zone map in the footer for each object type with INT fields: for
+  //   each block of *blockSize objects the min and max of each INT field of the object line.
+  //   oneZoneBlocks() returns the number of blocks, 0 if there is no zone map, e.g. ascii.
+  //   Block b holds objects b*blockSize+1 to (b+1)*blockSize, so to scan only the blocks that
+  //   can match, e.g. A lines of .1aln files on sequence id:
+  //       nb = oneZoneBlocks (of, 'A', &K) ;
+  //       for (b = 0 ; b < nb ; ++b)
+  //         if (oneZoneRange (of, 'A', b, 0, &min, &max) && min <= id && max >= id)
+  //           { oneGoto (of, 'A', b*K+1) ; ... read up to K objects ... }
+  //   oneZoneRange() returns false if the block or field is out of range or not an INT.
+
 #define oneReferenceCount(of)   ((of)->info['<'] ? (of)->info['<']->accum.count : 0)
 #define oneProvenanceCount(of)  ((of)->info['!'] ? (of)->info['<']->accum.count : 0)
 
@@ -449,6 +639,15 @@ void oneUserBuffer (OneFile *of, char lineType, void *buffer);
   //   (if any) is freed.  The user must ensure that a buffer they supply is large
   //   enough. BTW, this buffer is overwritten with each new line read of the given type.
 
+bool oneSkipList (OneFile *of, char lineType, bool isSkip);
+
+  // If isSkip is true, then when reading a binary file the list of each lineType line is
+  //   stepped over without being read, decompressed or expanded.  oneReadLine() still returns
+  //   the line with its fields and oneLen(), but the list accessors (oneIntList() etc.) return
+  //   NULL.  Use this for bulky lists that are not needed, e.g. T and X traces in .1aln files.
+  //   Applies to all the thread OneFiles if called on a threaded master.  Returns false if
+  //   lineType has no list, or if it is a STRING_LIST, which can't be skipped.
+
 /***********************************************************************************
  *
  *    A BIT ABOUT THE FORMAT OF BINARY FILES
@@ -465,7 +664,8 @@ void oneUserBuffer (OneFile *of, char lineType, void *buffer);
  // The ASCII prolog contains the type, subtype, provenance, reference, and deferred lines
  //   in the ASCII format.  The ONE count statistic lines for each data line type are found
  //   in the footer along with binary ';' lines that encode their compressors as needed.
- //   The footer also contains binary '&' lines that encode the byte index for object types.
+ //   The footer also contains binary '&' lines that encode the byte index for object types,
+ //   and binary '*' zone map lines for object types with INT fields, sized by an '@ *' line.
  //
  //   <Binary line> <- <Binary line code + tags> <fields> [<list data>]
  //
@@ -57,22 +57,594 @@ static IndexList *parseIndexList (char *s)
   return ol0 ; 
 }
 
+static int parseFieldList (char *s, int *field, int max, char *what) // comma separated, returns n
+{
+  int n = 0 ;
+  while (*s)
+    { if (*s < '0' || *s > '9') die ("bad %s field list at %s", what, s) ;
+      if (n == max) die ("too many %s fields", what) ;
+      field[n] = 0 ;
+      while (*s >= '0' && *s <= '9') field[n] = field[n]*10 + (*s++ - '0') ;
+      ++n ;
+      if (*s == ',') ++s ;
+      else if (*s) die ("unrecognised character %c at %s in %s list", *s, s, what) ;
+    }
+  return n ;
+}
+
+static int parseRangeKeys (char *s, int *keyField) // comma separated triples, returns nKey
+{
+  int n = parseFieldList (s, keyField, 3*32, "range key") ;
+  if (!n || n % 3) die ("range keys must be triples of id,start,end field numbers") ;
+  return n/3 ;
+}
+
+static IndexList *addObject (IndexList *ol, I64 obj) // extend the last run, or start a new one
+{
+  if (obj == ol->iN && ol->i0) { ++ol->iN ; return ol ; }
+  ol->next = new0 (1, IndexList) ;
+  ol = ol->next ;
+  ol->i0 = obj ; ol->iN = obj + 1 ;
+  return ol ;
+}
+
+static IndexList *regionObjects (OneFile *vf, char *region, char *indexType,
+				 char rangeType, int nRangeKey, int *rangeKey)
+{ // region is [k/]id:start-end or [k/]id, objects as an IndexList headed by the preamble
+  I64 key = 0, id, start = 0, end = ((I64)1) << 62 ;
+  char *s = region ;
+  if (strchr (s, '/')) { key = strtoll (s, &s, 10) ; if (*s++ != '/') die ("bad region %s", region) ; }
+  id = strtoll (s, &s, 10) ;
+  if (*s == ':')
+    { start = strtoll (s+1, &s, 10) ;
+      if (*s++ != '-') die ("bad region %s - need id:start-end", region) ;
+      end = strtoll (s, &s, 10) ;
+    }
+  if (*s) die ("bad region %s - need [k/]id[:start-end]", region) ;
+
+  IndexList *ol, *ol0 = ol = new0 (1, IndexList) ;
+  ol->iN = 1 ; // object 0 writes the lines before the first object, as for -i
+
+  char *indexName = new (strlen(vf->fileName) + 6, char) ;
+  sprintf (indexName, "%s.1rix", vf->fileName) ;
+  OneRangeIndex *rx = oneRangeIndexRead (indexName, vf) ;
+  I64 K, nb ;
+  if (rx)
+    { I64 *obj, n = oneRangeQuery (rx, key, id, start, end, &obj), i ;
+      for (i = 0 ; i < n ; ++i) ol = addObject (ol, obj[i]) ;
+      *indexType = oneRangeIndexType (rx) ;
+      oneRangeIndexDestroy (rx) ;
+    }
+  else if (key < nRangeKey && (nb = oneZoneBlocks (vf, rangeType, &K)))
+    { int *kf = rangeKey + 3*key ;  // no range index, so scan the blocks the zone map allows
+      I64  b, min, max, lo, hi ;
+      for (b = 0 ; b < nb ; ++b)
+	{ if (!oneZoneRange (vf, rangeType, b, kf[0], &min, &max) || min > id || max < id ||
+	      !oneZoneRange (vf, rangeType, b, kf[1], &lo, &hi) || lo >= end ||
+	      !oneZoneRange (vf, rangeType, b, kf[2], &lo, &hi) || hi <= start)
+	    continue ;
+	  if (!oneGoto (vf, rangeType, b*K + 1))
+	    die ("can't locate to object %c %lld", rangeType, b*K + 1) ;
+	  while (oneReadLine (vf))
+	    if (vf->lineType == rangeType)
+	      { I64 obj = oneObject (vf, (int)rangeType) ;
+		if (obj > (b+1)*K) break ;
+		if (oneInt(vf,kf[0]) == id && oneInt(vf,kf[1]) < end && oneInt(vf,kf[2]) > start)
+		  ol = addObject (ol, obj) ;
+	      }
+	}
+      *indexType = rangeType ;
+    }
+  else
+    { fprintf (stderr, "%s", oneErrorString()) ;
+      die ("no usable range index %s or zone map for %s - make one with ONEview -I",
+	   indexName, vf->fileName) ;
+    }
+  free (indexName) ;
+
+  return ol0 ;
+}
+
+static bool isDrop[128] ;	// line types not to write
+
 static void transferLine (OneFile *vfIn, OneFile *vfOut, size_t *fieldSize)
-{ memcpy (vfOut->field, vfIn->field, fieldSize[(int)vfIn->lineType]) ;
+{ if (isDrop[(int)vfIn->lineType]) return ;
+  memcpy (vfOut->field, vfIn->field, fieldSize[(int)vfIn->lineType]) ;
   oneWriteLine (vfOut, vfIn->lineType, oneLen(vfIn), oneString(vfIn)) ;
   char *s = oneReadComment (vfIn) ; if (s) oneWriteComment (vfOut, "%s", s) ;
 }
 
+static void addCounts (OneFile *vfOut, OneFile *vfIn) // for the ascii header of a concatenation
+{
+  int k ;
+  for (k = 0 ; k < vfIn->nDefn ; ++k)
+    { int i = vfIn->defnOrder[k] ;
+      if (i & 0x80 || !vfOut->info[i]) continue ;
+      OneInfo *li = vfOut->info[i], *lj = vfIn->info[i] ;
+      li->given.count += lj->given.count ;
+      li->given.total += lj->given.total ;
+      if (lj->given.max > li->given.max) li->given.max = lj->given.max ;
+      OneStat *s, *s1 ;
+      for (s = li->stats ; s && s->type ; ++s)
+	for (s1 = lj->stats ; s1 && s1->type ; ++s1)
+	  if (s1->type == s->type)
+	    { if (s1->maxCount > s->maxCount) s->maxCount = s1->maxCount ;
+	      if (s1->maxTotal > s->maxTotal) s->maxTotal = s1->maxTotal ;
+	    }
+    }
+}
+
+static bool isCounted (OneFile *vf) // true if the header gave counts for some line type
+{
+  int i ;
+  for (i = 'A' ; i <= 'z' ; ++i)
+    if (vf->info[i] && vf->info[i]->given.count) return true ;
+  return false ;
+}
+
+static OneFile *countFile (OneFile *vf, OneSchema *vs, char *fileType)
+{
+  // An ascii file may have no '#' lines.  Then we find its counts and object stats by writing
+  // it to /dev/null, and reopen it with them set as though given, for addCounts().
+
+  OneFile *vfNull = oneFileOpenWriteFrom ("/dev/null", vf, false, 1) ;
+  if (!vfNull) die ("failed to open /dev/null to count %s", vf->fileName) ;
+  vfNull->isNoAsciiHeader = true ;
+  while (oneReadLine (vf)) oneWriteLineFrom (vfNull, vf) ;
+  oneFinalizeCounts (vfNull) ;
+
+  OneFile *vfNew = oneFileOpenRead (vf->fileName, vs, fileType, 1) ;
+  if (!vfNew) die ("failed to reopen one file %s", vf->fileName) ;
+  int i ;
+  for (i = 'A' ; i <= 'z' ; ++i)
+    if (vfNew->info[i] && vfNull->info[i])
+      { OneInfo *li = vfNew->info[i], *lj = vfNull->info[i] ;
+	li->given = lj->accum ;
+	OneStat *s, *s1 ;
+	for (s = li->stats ; s && s->type ; ++s)
+	  for (s1 = lj->stats ; s1 && s1->type ; ++s1)
+	    if (s1->type == s->type)
+	      { s->maxCount = s1->maxCount ; s->maxTotal = s1->maxTotal ; }
+      }
+  oneFileClose (vfNull) ;
+  oneFileClose (vf) ;
+  return vfNew ;
+}
+
+/***************** parallel conversion ******************/
+
+// Each thread t reads with vfIn+t and writes with vfOut+t.  The slave output files are
+// appended in thread order when vfOut is closed, and oneFinalizeCounts() merges their
+// counts and indexes, so thread t just has to convert the t'th piece of the input.
+
+typedef struct {
+  OneFile *vfIn, *vfOut ;
+  size_t  *fieldSize ;
+  char     type ;		// binary input: split by the index of this object type
+  off_t    end ;		// ascii input: this thread's chunk ends here
+  pthread_t thread ;
+} Convert ;
+
+static void *convertRange (OneFile *vfIn, I64 iStart, I64 iEnd, void *arg)
+{ Convert *c = (Convert*) arg ;
+  OneFile *vfOut = c->vfOut + (vfIn - c->vfIn) ;
+  while (vfIn->lineType && (vfIn->lineType != c->type || oneObject (vfIn, (int)c->type) < iEnd))
+    { transferLine (vfIn, vfOut, c->fieldSize) ;
+      oneReadLine (vfIn) ;
+    }
+  return 0 ;
+}
+
+static void *convertChunk (void *arg)
+{ Convert *c = (Convert*) arg ;
+  while (ftello (c->vfIn->f) < c->end && oneReadLine (c->vfIn))
+    transferLine (c->vfIn, c->vfOut, c->fieldSize) ;
+  return 0 ;
+}
+
+static off_t nextObjectLine (OneFile *vf, off_t pos, off_t end)
+{ // start of the first line after pos that begins with an object line type
+  int c, prev = 0 ;
+  if (fseeko (vf->f, pos, SEEK_SET) != 0) die ("failed to seek to %lld in %s", (I64)pos, vf->fileName) ;
+  while ((c = getc (vf->f)) != EOF)
+    { if (prev == '\n' && c < 128 && vf->info[c] && vf->info[c]->isObject)
+	{ off_t start = ftello (vf->f) - 1 ;
+	  if ((c = getc (vf->f)) == ' ' || c == '\n') return start ;
+	  if (c == EOF) break ;
+	}
+      prev = c ;
+    }
+  return end ;
+}
+
+static void convertParallel (OneFile *vfIn, OneFile *vfOut, size_t *fieldSize)
+{
+  int      t, nThreads = vfIn->share ;
+  Convert *c = new0 (nThreads, Convert) ;
+
+  for (t = 0 ; t < nThreads ; ++t)
+    { c[t].vfIn = vfIn + t ; c[t].vfOut = vfOut + t ; c[t].fieldSize = fieldSize ; }
+
+  if (vfIn->isBinary) // split the most numerous indexed object type between the threads
+    { I64 nMax = 0 ;
+      for (t = 0 ; t < 128 ; ++t)
+	if (vfIn->info[t] && vfIn->info[t]->isObject && vfIn->info[t]->index
+	    && vfIn->info[t]->given.count > nMax)
+	  { c->type = t ; nMax = vfIn->info[t]->given.count ; }
+      if (nMax)
+	{ while (oneReadLine (vfIn) && vfIn->lineType != c->type) // lines before the first object
+	    transferLine (vfIn, vfOut, fieldSize) ;
+	  c->vfIn = vfIn ; c->vfOut = vfOut ; // convertRange() only uses c[0]
+	  free (oneParallelScan (vfIn, c->type, convertRange, c)) ;
+	  free (c) ;
+	  return ;
+	}
+    }
+
+  // ascii, or binary with nothing to split by - chunks that start at object lines
+  off_t start = ftello (vfIn->f), end ;
+  if (fseeko (vfIn->f, 0, SEEK_END) != 0 || (end = ftello (vfIn->f)) < 0) // e.g. plain gzip
+    { if (fseeko (vfIn->f, start, SEEK_SET) != 0) die ("failed to seek back in %s", vfIn->fileName) ;
+      while (oneReadLine (vfIn))
+	transferLine (vfIn, vfOut, fieldSize) ;
+      free (c) ;
+      return ;
+    }
+  for (t = 0 ; t < nThreads-1 ; ++t)
+    { off_t target = start + (end - start) * (t+1) / nThreads ;
+      c[t].end = nextObjectLine (vfIn + t+1, target, end) ;
+      if (t && c[t].end < c[t-1].end) c[t].end = c[t-1].end ;
+    }
+  c[nThreads-1].end = end ;
+  for (t = 0 ; t < nThreads ; ++t)
+    if (fseeko (vfIn[t].f, t ? c[t-1].end : start, SEEK_SET) != 0)
+      die ("failed to seek to the start of chunk %d of %s", t, vfIn->fileName) ;
+  for (t = 1 ; t < nThreads ; ++t)
+    pthread_create (&c[t].thread, 0, convertChunk, &c[t]) ;
+  convertChunk (c) ;
+  for (t = 1 ; t < nThreads ; ++t)
+    pthread_join (c[t].thread, 0) ;
+  free (c) ;
+}
+
+/***************** object filter ******************/
+
+// A filter is a predicate on the lines of each object of one type, compiled to a postfix
+// program.  $n is field n of the object line itself, Xn or X.n is field n of the X line in
+// the object (the last one if several, 0 if none), #X counts the X lines in the object.
+// For list fields the value is the list length.  Operators are as in C: ( ) ! * / + - < <=
+// > >= == != && ||, and constants are numbers.  e.g. for .1aln files
+//     -f A '$2-$1 > 10000 && D0/($2-$1) < 0.05'
+// keeps alignments longer than 10kb in a with diffs below 5%.
+
+typedef enum { F_NUM, F_REF, F_COUNT, F_NEG, F_NOT, F_MUL, F_DIV, F_ADD, F_SUB,
+	       F_LT, F_LE, F_GT, F_GE, F_EQ, F_NE, F_AND, F_OR } FilterOp ;
+
+typedef struct {
+  FilterOp op ;
+  double   x ;			// F_NUM constant
+  int      k ;			// F_REF: index into ref[], F_COUNT: line type
+} FilterStep ;
+
+typedef struct {
+  char        type ;		// the object type filtered
+  int         nStep ;
+  FilterStep  step[256] ;
+  int         nRef ;
+  struct { char type ; int field ; double x ; } ref[64] ;
+  I64         count[128] ;	// lines of each type in the current object
+  double      stack[256] ;
+  OneFile    *vf ;		// for checking references while parsing
+  char       *s ;		// parse position
+} Filter ;
+
+static void filterEmit (Filter *fl, FilterOp op, double x, int k)
+{
+  if (fl->nStep == 256) die ("filter expression too long") ;
+  fl->step[fl->nStep].op = op ;
+  fl->step[fl->nStep].x = x ;
+  fl->step[fl->nStep++].k = k ;
+}
+
+static bool filterToken (Filter *fl, char *tok) // match tok after white space
+{
+  while (*fl->s == ' ' || *fl->s == '\t') ++fl->s ;
+  if (strncmp (fl->s, tok, strlen(tok))) return false ;
+  fl->s += strlen(tok) ;
+  return true ;
+}
+
+static void filterRef (Filter *fl, char t, int field)
+{
+  OneInfo *li = fl->vf->info[(int)t] ;
+  int      i ;
+  if (!li || (t != fl->type && !fl->vf->info[(int)fl->type]->contains[(int)t]))
+    die ("filter line type %c is not within %c objects", t, fl->type) ;
+  if (field < 0 || field >= li->nField)
+    die ("filter field %d out of range for line type %c with %d fields", field, t, li->nField) ;
+  for (i = 0 ; i < fl->nRef ; ++i)
+    if (fl->ref[i].type == t && fl->ref[i].field == field) break ;
+  if (i == fl->nRef)
+    { if (fl->nRef == 64) die ("too many fields in filter") ;
+      fl->ref[fl->nRef].type = t ; fl->ref[fl->nRef++].field = field ;
+    }
+  filterEmit (fl, F_REF, 0, i) ;
+}
+
+static void filterOr (Filter *fl) ;
+
+static void filterAtom (Filter *fl)
+{
+  char *e ;
+  if (filterToken (fl, "("))
+    { filterOr (fl) ;
+      if (!filterToken (fl, ")")) die ("missing ) in filter at %s", fl->s) ;
+    }
+  else if (filterToken (fl, "-"))
+    { filterAtom (fl) ; filterEmit (fl, F_NEG, 0, 0) ; }
+  else if (filterToken (fl, "!"))
+    { filterAtom (fl) ; filterEmit (fl, F_NOT, 0, 0) ; }
+  else if (filterToken (fl, "$"))
+    { int field = strtol (fl->s, &e, 10) ;
+      if (e == fl->s) die ("need a field number after $ in filter at %s", fl->s) ;
+      fl->s = e ;
+      filterRef (fl, fl->type, field) ;
+    }
+  else if (filterToken (fl, "#"))
+    { char t = *fl->s++ ;
+      if (!fl->vf->info[(int)t]) die ("unknown line type %c after # in filter", t) ;
+      filterEmit (fl, F_COUNT, 0, t) ;
+    }
+  else if ((*fl->s >= 'A' && *fl->s <= 'Z') || (*fl->s >= 'a' && *fl->s <= 'z'))
+    { char t = *fl->s++ ;
+      if (*fl->s == '.') ++fl->s ;
+      int field = strtol (fl->s, &e, 10) ;
+      if (e == fl->s) die ("need a field number after %c in filter at %s", t, fl->s) ;
+      fl->s = e ;
+      filterRef (fl, t, field) ;
+    }
+  else
+    { double x = strtod (fl->s, &e) ;
+      if (e == fl->s) die ("bad filter expression at %s", fl->s) ;
+      fl->s = e ;
+      filterEmit (fl, F_NUM, x, 0) ;
+    }
+}
+
+static void filterProduct (Filter *fl)
+{
+  filterAtom (fl) ;
+  while (true)
+    if (filterToken (fl, "*")) { filterAtom (fl) ; filterEmit (fl, F_MUL, 0, 0) ; }
+    else if (filterToken (fl, "/")) { filterAtom (fl) ; filterEmit (fl, F_DIV, 0, 0) ; }
+    else return ;
+}
+
+static void filterSum (Filter *fl)
+{
+  filterProduct (fl) ;
+  while (true)
+    if (filterToken (fl, "+")) { filterProduct (fl) ; filterEmit (fl, F_ADD, 0, 0) ; }
+    else if (filterToken (fl, "-")) { filterProduct (fl) ; filterEmit (fl, F_SUB, 0, 0) ; }
+    else return ;
+}
+
+static void filterCompare (Filter *fl)
+{
+  static struct { char *tok ; FilterOp op ; } cmp[] = // two character tokens first
+    { {"<=",F_LE}, {">=",F_GE}, {"==",F_EQ}, {"!=",F_NE}, {"<",F_LT}, {">",F_GT}, {0,0} } ;
+  int i ;
+  filterSum (fl) ;
+  for (i = 0 ; cmp[i].tok ; ++i)
+    if (filterToken (fl, cmp[i].tok))
+      { filterSum (fl) ; filterEmit (fl, cmp[i].op, 0, 0) ; return ; }
+}
+
+static void filterAnd (Filter *fl)
+{
+  filterCompare (fl) ;
+  while (filterToken (fl, "&&")) { filterCompare (fl) ; filterEmit (fl, F_AND, 0, 0) ; }
+}
+
+static void filterOr (Filter *fl)
+{
+  filterAnd (fl) ;
+  while (filterToken (fl, "||")) { filterAnd (fl) ; filterEmit (fl, F_OR, 0, 0) ; }
+}
+
+static Filter *filterCreate (OneFile *vf, char type, char *expr)
+{
+  Filter *fl = new0 (1, Filter) ;
+  if (!vf->info[(int)type] || !vf->info[(int)type]->isObject)
+    die ("filter type %c is not an object type in %s", type, vf->fileName) ;
+  fl->type = type ;
+  fl->vf = vf ;
+  fl->s = expr ;
+  filterOr (fl) ;
+  filterToken (fl, "") ; // skips trailing white space
+  if (*fl->s) die ("unexpected text in filter at %s", fl->s) ;
+  return fl ;
+}
+
+static void filterStart (Filter *fl)
+{
+  int i ;
+  for (i = 0 ; i < fl->nRef ; ++i) fl->ref[i].x = 0 ;
+  memset (fl->count, 0, sizeof(fl->count)) ;
+}
+
+static void filterAddLine (Filter *fl, OneFile *vf)
+{
+  int      i, t = vf->lineType ;
+  OneInfo *li = vf->info[t] ;
+  ++fl->count[t] ;
+  for (i = 0 ; i < fl->nRef ; ++i)
+    if (fl->ref[i].type == t)
+      { int f = fl->ref[i].field ;
+	switch (li->fieldType[f])
+	  {
+	  case oneINT: fl->ref[i].x = oneInt (vf, f) ; break ;
+	  case oneREAL: fl->ref[i].x = oneReal (vf, f) ; break ;
+	  case oneCHAR: fl->ref[i].x = oneChar (vf, f) ; break ;
+	  default: fl->ref[i].x = vf->field[f].len & 0xffffffffffffffll ; // a list
+	  }
+      }
+}
+
+static bool filterPass (Filter *fl)
+{
+  double *x = fl->stack - 1 ; // top of stack
+  int     i ;
+  for (i = 0 ; i < fl->nStep ; ++i)
+    { FilterStep *s = &fl->step[i] ;
+      switch (s->op)
+	{
+	case F_NUM: *++x = s->x ; break ;
+	case F_REF: *++x = fl->ref[s->k].x ; break ;
+	case F_COUNT: *++x = fl->count[s->k] ; break ;
+	case F_NEG: *x = -*x ; break ;
+	case F_NOT: *x = !*x ; break ;
+	case F_MUL: --x ; *x = x[0] * x[1] ; break ;
+	case F_DIV: --x ; *x = x[0] / x[1] ; break ;
+	case F_ADD: --x ; *x = x[0] + x[1] ; break ;
+	case F_SUB: --x ; *x = x[0] - x[1] ; break ;
+	case F_LT: --x ; *x = x[0] < x[1] ; break ;
+	case F_LE: --x ; *x = x[0] <= x[1] ; break ;
+	case F_GT: --x ; *x = x[0] > x[1] ; break ;
+	case F_GE: --x ; *x = x[0] >= x[1] ; break ;
+	case F_EQ: --x ; *x = x[0] == x[1] ; break ;
+	case F_NE: --x ; *x = x[0] != x[1] ; break ;
+	case F_AND: --x ; *x = x[0] && x[1] ; break ;
+	case F_OR: --x ; *x = x[0] || x[1] ; break ;
+	}
+    }
+  return *x != 0 ;
+}
+
+// Lines of an object read before the filter can be evaluated, when we can't go back to them.
+
+typedef struct {
+  char      type ;
+  OneField *field ;
+  I64       len ;
+  char     *list ;
+  char     *comment ;
+} SavedLine ;
+
+static void saveLine (SavedLine *sl, OneFile *vf, size_t *fieldSize)
+{
+  OneInfo *li = vf->info[(int)vf->lineType] ;
+  sl->type = vf->lineType ;
+  sl->field = new (li->nField ? li->nField : 1, OneField) ;
+  memcpy (sl->field, vf->field, fieldSize[(int)sl->type]) ;
+  sl->len = 0 ; sl->list = 0 ;
+  if (li->listEltSize)
+    { char *s = oneString (vf) ;
+      I64   size ;
+      sl->len = oneLen (vf) ;
+      if (li->fieldType[li->listField] == oneSTRING_LIST)
+	{ char *t = s ; I64 i ;
+	  for (i = 0 ; i < sl->len ; ++i) t = oneNextString (vf, t) ;
+	  size = t - s ;
+	}
+      else
+	size = sl->len * li->listEltSize + 1 ; // + 1 for the terminal 0 of a STRING
+      sl->list = new (size, char) ;
+      if (s) memcpy (sl->list, s, size) ;
+    }
+  char *c = oneReadComment (vf) ;
+  sl->comment = c ? strdup (c) : 0 ;
+}
+
+static void writeSavedLine (SavedLine *sl, OneFile *vfOut, size_t *fieldSize)
+{
+  memcpy (vfOut->field, sl->field, fieldSize[(int)sl->type]) ;
+  oneWriteLine (vfOut, sl->type, sl->len, sl->list) ;
+  if (sl->comment) oneWriteComment (vfOut, "%s", sl->comment) ;
+}
+
+static void freeSavedLine (SavedLine *sl)
+{
+  free (sl->field) ;
+  if (sl->list) free (sl->list) ;
+  if (sl->comment) free (sl->comment) ;
+}
+
+static void filterObjects (Filter *fl, OneFile *vfIn, OneFile *vfOut, size_t *fieldSize)
+{
+  // For an indexed binary file the lists of the lines inside objects are skipped while the
+  // filter is evaluated, and we go back to the start of objects that pass to copy them.
+  // Otherwise we save the lines of each object until we know whether to write them.
+  
+  char      T = fl->type ;
+  bool     *isInside = vfIn->info[(int)T]->contains ;
+  bool      isGoto = vfIn->isBinary && vfIn->info[(int)T]->index ;
+  bool      isSkip[128] ;
+  int       i, nSaved = 0, maxSaved = 0 ;
+  SavedLine *saved = 0 ;
+
+  for (i = 0 ; i < 128 ; ++i)
+    isSkip[i] = isGoto && isInside[i] && !isDrop[i] && oneSkipList (vfIn, i, true) ;
+  
+  oneReadLine (vfIn) ;
+  while (vfIn->lineType)
+    { if (vfIn->lineType != T) // outside the objects being filtered
+	{ transferLine (vfIn, vfOut, fieldSize) ;
+	  oneReadLine (vfIn) ;
+	  continue ;
+	}
+      I64 obj = oneObject (vfIn, (int)T) ;
+      filterStart (fl) ;
+      do
+	{ filterAddLine (fl, vfIn) ;
+	  if (!isGoto && !isDrop[(int)vfIn->lineType])
+	    { if (nSaved == maxSaved)
+		{ maxSaved = maxSaved ? 2*maxSaved : 64 ;
+		  resize (saved, nSaved, maxSaved, SavedLine) ;
+		}
+	      saveLine (&saved[nSaved++], vfIn, fieldSize) ;
+	    }
+	} while (oneReadLine (vfIn) && isInside[(int)vfIn->lineType]) ;
+      
+      if (filterPass (fl))
+	{ if (isGoto) // go back and read the object again with its lists
+	    { for (i = 0 ; i < 128 ; ++i) if (isSkip[i]) oneSkipList (vfIn, i, false) ;
+	      if (!oneGoto (vfIn, T, obj) || oneReadLine (vfIn) != T)
+		die ("can't go back to object %c %lld", T, obj) ;
+	      do transferLine (vfIn, vfOut, fieldSize) ;
+	      while (oneReadLine (vfIn) && isInside[(int)vfIn->lineType]) ;
+	      for (i = 0 ; i < 128 ; ++i) if (isSkip[i]) oneSkipList (vfIn, i, true) ;
+	    }
+	  else
+	    for (i = 0 ; i < nSaved ; ++i) writeSavedLine (&saved[i], vfOut, fieldSize) ;
+	}
+      for (i = 0 ; i < nSaved ; ++i) freeSavedLine (&saved[i]) ;
+      nSaved = 0 ;
+    }
+
+  for (i = 0 ; i < 128 ; ++i) if (isSkip[i]) oneSkipList (vfIn, i, false) ;
+  if (saved) free (saved) ;
+}
+
 int main (int argc, char **argv)
 {
   I64 i ;
   char *fileType = 0 ;
   char *outFileName = "-" ;
   char *schemaFileName = 0 ;
+  char *saveCodecFileName = 0, *useCodecFileName = 0 ;
   bool  isNoHeader = false, isHeaderOnly = false, isWriteSchema = false, 
     isBinary = false, isVerbose = false ;
   char  indexType = 0 ;
   IndexList *objList = 0 ;
+  bool  isRangeIndex = false ;
+  char  rangeType = 0, *region = 0 ;
+  int   nRangeKey = 0, rangeKey[3*32] ;
+  int   nThreads = 1 ;
+  char  filterType = 0, *filterExpr = 0, *dropTypes = "" ;
+  char  sortType = 0 ;
+  int   nSortKey = 0, sortKey[4] ;
+  I64   sortMemory = 1024 ;
   
   timeUpdate (0) ;
 
@@ -80,17 +652,39 @@ int main (int argc, char **argv)
   --argc ; ++argv ;		/* drop the program name */
 
   if (!argc)
-    { fprintf (stderr, "ONEview [options] onefile\n") ;
+    { fprintf (stderr, "ONEview [options] onefile [onefile ...]\n") ;
       fprintf (stderr, "  -t --type <abc>           file type, e.g. seq, aln - required if no header\n") ;
       fprintf (stderr, "  -S --schema <schemafile>      schema file name for reading file\n") ;
       fprintf (stderr, "  -h --noHeader                 skip the header in ascii output\n") ;
       fprintf (stderr, "  -H --headerOnly               only write the header (in ascii)\n") ;
       fprintf (stderr, "  -s --writeSchema              write a schema file based on this file\n") ;
       fprintf (stderr, "  -b --binary                   write in binary (default is ascii)\n") ;
+      fprintf (stderr, "  -c --saveCodecs <codecfile>   save the input's trained codecs, e.g. for -C\n") ;
+      fprintf (stderr, "  -C --useCodecs <codecfile>    compress binary output with saved codecs\n") ;
       fprintf (stderr, "  -o --output <filename>        output file name (default stdout)\n") ;
       fprintf (stderr, "  -i --index T x[-y](,x[-y])*   write specified objects/groups of type T\n") ;
+      fprintf (stderr, "  -r --region [k/]id[:start-end] write objects overlapping region, using a range index\n") ;
+      fprintf (stderr, "  -I --rangeIndex               write range index <onefile>.1rix for -r, then exit\n") ;
+      fprintf (stderr, "  -k --rangeKeys T i,s,e(,i,s,e)* object type and id,start,end fields of keys\n") ;
+#ifdef ONE_STATS
+      fprintf (stderr, "  -v --verbose                  write commentary including timing and I/O counters\n") ;
+#else
       fprintf (stderr, "  -v --verbose                  write commentary including timing\n") ;
+#endif
+      fprintf (stderr, "  -T --threads <n>              number of threads for whole file conversion [1]\n") ;
+      fprintf (stderr, "  -f --filter T <expr>          only write objects of type T for which expr is true\n") ;
+      fprintf (stderr, "  -x --drop <types>             don't write lines of these types, e.g. TX\n") ;
+      fprintf (stderr, "  -z --sort T f(,f)*            sort objects of type T on up to 4 INT fields\n") ;
+      fprintf (stderr, "  -M --sortMemory <n>           Mb of objects to sort in memory, then merge runs [1024]\n") ;
+      fprintf (stderr, "several files are concatenated, copying data blocks where binary in and out\n") ;
       fprintf (stderr, "index only works for binary files; '-i A 0-10' outputs first 10 objects of type A\n") ;
+      fprintf (stderr, "range keys default for aln files to 'A 0,1,2,3,4,5', so key 0 is a, 1 is b\n") ;
+      fprintf (stderr, "without a range index -r scans the blocks allowed by the binary file's zone map\n") ;
+      fprintf (stderr, "  e.g. '-r 17:20000000-21000000' gives alignments on a sequence 17 in that range\n") ;
+      fprintf (stderr, "e.g. for aln '-z A 3,0,4' sorts alignments by bread, aread, bbpos\n") ;
+      fprintf (stderr, "filter expressions use $n for field n of the T line, Xn for field n of the X line\n") ;
+      fprintf (stderr, "  in the object, #X for the number of X lines, numbers and C operators ( ) ! * / + -\n") ;
+      fprintf (stderr, "  < <= > >= == != && ||, e.g. for aln -f A '$2-$1 > 10000 && D0/($2-$1) < 0.05'\n") ;
       exit (0) ;
     }
   
@@ -113,23 +707,104 @@ int main (int argc, char **argv)
       { isBinary = true ; --argc ; ++argv ; }
     else if (!strcmp (*argv, "-v") || !strcmp (*argv, "--verbose"))
       { isVerbose = true ; --argc ; ++argv ; }
+    else if ((!strcmp (*argv, "-f") || !strcmp (*argv, "--filter")) && argc >= 3)
+      { filterType = *argv[1] ; filterExpr = argv[2] ; argc -= 3 ; argv += 3 ; }
+    else if ((!strcmp (*argv, "-x") || !strcmp (*argv, "--drop")) && argc >= 2)
+      { dropTypes = argv[1] ; argc -= 2 ; argv += 2 ; }
+    else if ((!strcmp (*argv, "-z") || !strcmp (*argv, "--sort")) && argc >= 3)
+      { sortType = *argv[1] ; nSortKey = parseFieldList (argv[2], sortKey, 4, "sort key") ;
+	argc -= 3 ; argv += 3 ;
+      }
+    else if ((!strcmp (*argv, "-M") || !strcmp (*argv, "--sortMemory")) && argc >= 2)
+      { sortMemory = atoll (argv[1]) ; argc -= 2 ; argv += 2 ;
+	if (sortMemory < 1) die ("sort memory %lld Mb must be positive", sortMemory) ;
+      }
+    else if ((!strcmp (*argv, "-T") || !strcmp (*argv, "--threads")) && argc >= 2)
+      { nThreads = atoi (argv[1]) ; argc -= 2 ; argv += 2 ;
+	if (nThreads < 1) die ("number of threads %d must be positive", nThreads) ;
+      }
+    else if ((!strcmp (*argv, "-c") || !strcmp (*argv, "--saveCodecs")) && argc >= 2)
+      { saveCodecFileName = argv[1] ; argc -= 2 ; argv += 2 ; }
+    else if ((!strcmp (*argv, "-C") || !strcmp (*argv, "--useCodecs")) && argc >= 2)
+      { useCodecFileName = argv[1] ; argc -= 2 ; argv += 2 ; }
     else if ((!strcmp (*argv, "-o") || !strcmp (*argv, "--output")) && argc >= 2)
       { outFileName = argv[1] ; argc -= 2 ; argv += 2 ; }
     else if ((!strcmp (*argv, "-i") || !strcmp (*argv, "--index")) && argc >= 3)
       { indexType = *argv[1] ; objList = parseIndexList (argv[2]) ; argc -= 3 ; argv += 3 ; }
+    else if ((!strcmp (*argv, "-r") || !strcmp (*argv, "--region")) && argc >= 2)
+      { region = argv[1] ; argc -= 2 ; argv += 2 ; }
+    else if (!strcmp (*argv, "-I") || !strcmp (*argv, "--rangeIndex"))
+      { isRangeIndex = true ; --argc ; ++argv ; }
+    else if ((!strcmp (*argv, "-k") || !strcmp (*argv, "--rangeKeys")) && argc >= 3)
+      { rangeType = *argv[1] ; nRangeKey = parseRangeKeys (argv[2], rangeKey) ; argc -= 3 ; argv += 3 ; }
     else die ("unknown option %s - run without arguments to see options", *argv) ;
 
   if (isBinary) isNoHeader = false ;
   if (isHeaderOnly) isBinary = false ;
     
-  if (argc != 1)
-    die ("need a single data one-code file as argument") ;
+  if (argc < 1)
+    die ("need a data one-code file as argument") ;
+  int nCat = argc - 1 ; // further files to concatenate on to the first
+  if (nCat && (objList || region || isRangeIndex || isWriteSchema || saveCodecFileName
+	       || isHeaderOnly || filterExpr || *dropTypes))
+    die ("can only concatenate whole files, without -i -r -I -s -c -H -f or -x") ;
 
   OneSchema *vs = 0 ;
   if (schemaFileName && !(vs = oneSchemaCreateFromFile (schemaFileName)))
     die ("failed to read schema file %s", schemaFileName) ;
-  OneFile *vfIn = oneFileOpenRead (argv[0], vs, fileType, 1) ; /* reads the header */
+  if (filterExpr && (objList || region)) die ("can't use -f with -i or -r") ;
+  if (sortType && (objList || region || filterExpr || *dropTypes || nCat))
+    die ("can only sort a whole single file, without -i -r -f or -x") ;
+  if (objList || region || isRangeIndex || isWriteSchema || saveCodecFileName || isHeaderOnly
+      || filterExpr || nCat || sortType || !strcmp (argv[0], "-"))
+    nThreads = 1 ; // threads are only for converting the whole of a file
+  OneFile *vfIn = oneFileOpenRead (argv[0], vs, fileType, nThreads) ; /* reads the header */
   if (!vfIn) die ("failed to open one file %s", argv[0]) ;
+  OneFile **vfCat = new (nCat+1, OneFile*) ;
+  for (i = 1 ; i <= nCat ; ++i)
+    if (!(vfCat[i] = oneFileOpenRead (argv[i], vs, fileType, 1)))
+      die ("failed to open one file %s", argv[i]) ;
+  if (nCat && !isBinary) // the ascii header counts must cover files without '#' lines too
+    { vfCat[0] = vfIn ;
+      for (i = 0 ; i <= nCat && !isCounted (vfCat[i]) ; ++i) ;
+      if (i <= nCat) // some file has counts, so the rest need them
+	for (i = 0 ; i <= nCat ; ++i)
+	  if (!isCounted (vfCat[i]) && strcmp (argv[i], "-"))
+	    vfCat[i] = countFile (vfCat[i], vs, fileType) ;
+      vfIn = vfCat[0] ;
+    }
+
+  for ( ; *dropTypes ; ++dropTypes)
+    { if (!vfIn->info[(int)*dropTypes]) die ("drop type %c is not in %s", *dropTypes, argv[0]) ;
+      isDrop[(int)*dropTypes] = true ;
+      oneSkipList (vfIn, *dropTypes, true) ; // don't decode what we won't write
+    }
+  Filter *filter = filterExpr ? filterCreate (vfIn, filterType, filterExpr) : 0 ;
+
+  if (!nRangeKey && !strcmp (vfIn->fileType, "aln"))
+    { rangeType = 'A' ; nRangeKey = 2 ;
+      for (i = 0 ; i < 6 ; ++i) rangeKey[i] = i ;
+    }
+
+  if (isRangeIndex)
+    { if (!nRangeKey) die ("need -k to say what to index in a %s file", vfIn->fileType) ;
+      char *indexName = new (strlen(argv[0]) + 6, char) ;
+      sprintf (indexName, "%s.1rix", argv[0]) ;
+      if (!oneRangeIndexWrite (vfIn, indexName, rangeType, nRangeKey, rangeKey))
+	die ("failed to write range index %s: %s", indexName, oneErrorString()) ;
+      if (isVerbose) fprintf (stderr, "wrote range index %s\n", indexName) ;
+      free (indexName) ;
+      oneFileClose (vfIn) ;
+      if (vs) oneSchemaDestroy (vs) ;
+      free (command) ;
+      if (isVerbose) timeTotal (stderr) ;
+      exit (0) ;
+    }
+
+  if (region)
+    { if (objList) die ("can't use both -i and -r") ;
+      objList = regionObjects (vfIn, region, &indexType, rangeType, nRangeKey, rangeKey) ;
+    }
 
   if (objList)
     { if (!vfIn->isBinary)
@@ -142,18 +817,28 @@ int main (int argc, char **argv)
 
   if (isWriteSchema)
     { oneFileWriteSchema (vfIn, outFileName) ; }
+  else if (saveCodecFileName)
+    { if (!oneCodecsWrite (vfIn, saveCodecFileName))
+	die ("failed to save codecs to %s: %s", saveCodecFileName, oneErrorString()) ;
+    }
   else
-    { OneFile *vfOut = oneFileOpenWriteFrom (outFileName, vfIn, isBinary, 1) ;
+    { OneFile *vfOut = oneFileOpenWriteFrom (outFileName, vfIn, isBinary, nThreads) ;
       if (!vfOut) die ("failed to open output file %s", outFileName) ;
+      if (useCodecFileName && (!isBinary || !oneCodecsLoad (vfOut, useCodecFileName)))
+	die ("failed to use codecs from %s: %s", useCodecFileName,
+	     isBinary ? oneErrorString() : "output is not binary") ;
       if (!isBinary) // need to copy across the object stats, so they write out into the header
-	for (i = 0 ; i < vfIn->nDefn ; ++i)
-	  { int k = vfIn->defnOrder[i] ;
-	    if (!(k & 0x80) && vfIn->info[k]->stats)
-	      { int n = 1 ; OneStat *s ;
-		for (s = vfIn->info[k]->stats ; s->type ; ++s) ++n ;
-		vfOut->info[k]->stats = new0 (n, OneStat) ;
-		memcpy (vfOut->info[k]->stats, vfIn->info[k]->stats, n*sizeof(OneStat)) ;
-	      }
+	{ for (i = 0 ; i < vfIn->nDefn ; ++i)
+	    { int k = vfIn->defnOrder[i] ;
+	      if (!(k & 0x80) && vfIn->info[k]->stats)
+		{ int n = 1 ; OneStat *s ;
+		  for (s = vfIn->info[k]->stats ; s->type ; ++s) ++n ;
+		  vfOut->info[k]->stats = new0 (n, OneStat) ;
+		  memcpy (vfOut->info[k]->stats, vfIn->info[k]->stats, n*sizeof(OneStat)) ;
+		}
+	    }
+	  for (i = 1 ; i <= nCat ; ++i) // the header counts must cover all the files
+	    addCounts (vfOut, vfCat[i]) ;
 	}
 	
       if (isNoHeader) vfOut->isNoAsciiHeader = true ; // will have no effect if binary
@@ -189,14 +874,34 @@ int main (int argc, char **argv)
 		  }
 		objList = objList->next ;
 	      }
+	  else if (sortType)
+	    { if (!oneSortObjects (vfIn, vfOut, sortType, nSortKey, sortKey, sortMemory << 20))
+		die ("failed to sort: %s", oneErrorString()) ;
+	    }
+	  else if (nCat)
+	    { vfCat[0] = vfIn ;
+	      for (i = 0 ; i <= nCat ; ++i)
+		if (!oneFileCat (vfOut, vfCat[i]))
+		  die ("failed to concatenate %s: %s", argv[i], oneErrorString()) ;
+	    }
+	  else if (filter)
+	    filterObjects (filter, vfIn, vfOut, fieldSize) ;
+	  else if (nThreads > 1)
+	    convertParallel (vfIn, vfOut, fieldSize) ;
 	  else
 	    while (oneReadLine (vfIn))
 	      transferLine (vfIn, vfOut, fieldSize) ;
 	}
       oneFileClose (vfOut) ;
     }
-      
+
+#ifdef ONE_STATS // the counters are only collected in ONElib built with the same flag
+  if (isVerbose) oneReportStats (vfIn, stderr) ;
+#endif
+  if (filter) free (filter) ;
   oneFileClose (vfIn) ;
+  for (i = 1 ; i <= nCat ; ++i) oneFileClose (vfCat[i]) ;
+  free (vfCat) ;
   if (vs) oneSchemaDestroy (vs) ;
   
   free (command) ;
@@ -87,6 +87,9 @@ typedef struct {
   I64   *ctgLen ;	 	// contig lengths
   int   *ctgSeq ;	 	// parent sequence for each contig
   I64   *ctgPos ;	 	// offset in parent of each contig
+  U8    *bps ;		// mapped 2-bit bases of the contigs, if gdbOpenBases() succeeded
+  I64    bpsSize ;
+  I64   *ctgBoff ;	 	// offset in bps of each contig
 #ifdef GDB_MASK
   I64    maxMask, totMask ;  // max and total length of masks
   int   *ctgMaskCount ;  	// number of masks in each contig
@@ -133,6 +136,17 @@ void writeGdb (OneFile *of, Gdb *gdb, int k, FILE *report) ;
 
 void gdbDestroy (Gdb *gdb) ;
 
+bool gdbOpenBases (Gdb *gdb, char *gdbFileName) ;
+// maps the hidden .root.bps file next to root.1gdb, made by FastGA, which holds the contigs
+// packed 4 bases per byte, first base in the top 2 bits, acgt = 0123, each starting a new byte
+// gdbFileName can be 0 to use gdb->seqFileName, as in a skeleton; returns false if not there
+char *gdbCtgText (Gdb *gdb, int ctg, I64 start, I64 end, char *s, const char *alphabet) ;
+// writes bases [start,end) of contig ctg into s (allocated if 0) mapping 0123 via alphabet,
+// e.g. "acgt" or "ACGT", and 0-terminates it
+
+static inline U8 *gdbCtgPacked (Gdb *gdb, int ctg) { return gdb->bps + gdb->ctgBoff[ctg] ; }
+static inline int gdbBase (U8 *u, I64 i) { return (u[i >> 2] >> (6 - 2*(i & 3))) & 3 ; }
+
 OneFile *gdbFile (OneFile *ofAln, int number) ;
 
 /************************ end of file *************************/
@@ -0,0 +1,219 @@
+/*  File: dnapack.h
+ *-------------------------------------------------------------------
+ * Description: 2-bit DNA packing kernels shared by ONElib and seqio
+ *   Packing is little-endian, 4 bases per byte with the first base in the low 2 bits.
+ *   acgt and ACGT and 0123 map to 0123; anything else (N etc.) maps to 0 = a.
+ *   On x86_64 there are SSE2 kernels, always available, and AVX2 kernels chosen at run
+ *   time if the CPU has them.  Elsewhere, and for the ends, simple byte loops are used.
+ * Exported functions: dnaPack2bit(), dnaUnpack2bit()
+ * Created: Sat Oct 17 2026
+ *-------------------------------------------------------------------
+ */
+
+#ifndef DNAPACK_DEFINED
+#define DNAPACK_DEFINED
+
+#include <stdint.h>
+
+/* dnaPack2bit() writes (len+3)/4 bytes into u
+   dnaUnpack2bit() writes len characters into s, base i mapping to alphabet[i] for i in 0..3
+*/
+
+static inline void dnaPack2bit (const char *s, uint8_t *u, int64_t len) ;
+static inline void dnaUnpack2bit (const uint8_t *u, char *s, int64_t len, const char *alphabet) ;
+
+/************** the rest of this file is implementation *************/
+
+static inline uint8_t dnaCode (uint8_t c)
+{
+  switch (c)
+    {
+    case 'c': case 'C': case 1: return 1 ;
+    case 'g': case 'G': case 2: return 2 ;
+    case 't': case 'T': case 3: return 3 ;
+    default: return 0 ;
+    }
+}
+
+static inline void dnaPackTail (const uint8_t *s, uint8_t *u, int64_t len)
+{
+  int j ;
+  while (len > 0)
+    { uint8_t x = 0 ;
+      for (j = 0 ; j < 4 && j < len ; ++j) x |= dnaCode (s[j]) << 2*j ;
+      *u++ = x ; s += 4 ; len -= 4 ;
+    }
+}
+
+static inline void dnaUnpackTail (const uint8_t *u, char *s, int64_t len, const char *alphabet)
+{
+  int j ;
+  while (len > 0)
+    { uint8_t x = *u++ ;
+      for (j = 0 ; j < 4 && j < len ; ++j, x >>= 2) s[j] = alphabet[x & 3] ;
+      s += 4 ; len -= 4 ;
+    }
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+
+#include <immintrin.h>
+
+/* Pack: first send each character to its code 0..3 with byte compares (0x20 folds case,
+   and cannot make 0..3 look like a letter), then fold pairs of codes in 16-bit lanes and
+   pairs of those in 32-bit lanes, so each 32-bit lane holds one packed byte at the bottom.
+   Saturating packs (all values are <= 255) then collect the bytes.
+   Unpack: replicate each byte 4 times, mask out the 2 bits for that position, and compare
+   against the 3 non-zero values to select the output character.
+*/
+
+static inline __m128i dnaCodes128 (__m128i x)
+{
+  __m128i lc = _mm_or_si128 (x, _mm_set1_epi8 (0x20)) ;
+  __m128i c  = _mm_cmpeq_epi8 (lc, _mm_set1_epi8 ('c')) ;
+  __m128i g  = _mm_cmpeq_epi8 (lc, _mm_set1_epi8 ('g')) ;
+  __m128i t  = _mm_cmpeq_epi8 (lc, _mm_set1_epi8 ('t')) ;
+  c = _mm_or_si128 (c, _mm_cmpeq_epi8 (x, _mm_set1_epi8 (1))) ;
+  g = _mm_or_si128 (g, _mm_cmpeq_epi8 (x, _mm_set1_epi8 (2))) ;
+  t = _mm_or_si128 (t, _mm_cmpeq_epi8 (x, _mm_set1_epi8 (3))) ;
+  x = _mm_or_si128 (_mm_and_si128 (c, _mm_set1_epi8 (1)), _mm_and_si128 (g, _mm_set1_epi8 (2))) ;
+  x = _mm_or_si128 (x, _mm_and_si128 (t, _mm_set1_epi8 (3))) ;
+  x = _mm_or_si128 (x, _mm_srli_epi16 (x, 6)) ;
+  x = _mm_or_si128 (x, _mm_srli_epi32 (x, 12)) ;
+  return _mm_and_si128 (x, _mm_set1_epi32 (0xff)) ;
+}
+
+static inline void dnaPackSSE2 (const uint8_t *s, uint8_t *u, int64_t n) /* n bytes out */
+{
+  for ( ; n >= 16 ; n -= 16, s += 64, u += 16)
+    { __m128i x0 = dnaCodes128 (_mm_loadu_si128 ((const __m128i*) s)) ;
+      __m128i x1 = dnaCodes128 (_mm_loadu_si128 ((const __m128i*) (s+16))) ;
+      __m128i x2 = dnaCodes128 (_mm_loadu_si128 ((const __m128i*) (s+32))) ;
+      __m128i x3 = dnaCodes128 (_mm_loadu_si128 ((const __m128i*) (s+48))) ;
+      _mm_storeu_si128 ((__m128i*) u, _mm_packus_epi16 (_mm_packs_epi32 (x0, x1),
+							 _mm_packs_epi32 (x2, x3))) ;
+    }
+}
+
+static inline __m128i dnaChars128 (__m128i x, __m128i a, __m128i ac, __m128i ag, __m128i at)
+{
+  __m128i mask = _mm_set1_epi32 ((int) 0xc0300c03) ;
+  x = _mm_and_si128 (x, mask) ;
+  ac = _mm_and_si128 (ac, _mm_cmpeq_epi8 (x, _mm_set1_epi32 (0x40100401))) ;
+  ag = _mm_and_si128 (ag, _mm_cmpeq_epi8 (x, _mm_set1_epi32 ((int) 0x80200802))) ;
+  at = _mm_and_si128 (at, _mm_cmpeq_epi8 (x, mask)) ;
+  return _mm_xor_si128 (_mm_xor_si128 (a, ac), _mm_xor_si128 (ag, at)) ;
+}
+
+static inline void dnaUnpackSSE2 (const uint8_t *u, char *s, int64_t n, const char *alphabet)
+{
+  __m128i a  = _mm_set1_epi8 (alphabet[0]) ;
+  __m128i ac = _mm_xor_si128 (a, _mm_set1_epi8 (alphabet[1])) ;
+  __m128i ag = _mm_xor_si128 (a, _mm_set1_epi8 (alphabet[2])) ;
+  __m128i at = _mm_xor_si128 (a, _mm_set1_epi8 (alphabet[3])) ;
+  for ( ; n >= 16 ; n -= 16, u += 16, s += 64)
+    { __m128i x  = _mm_loadu_si128 ((const __m128i*) u) ;
+      __m128i lo = _mm_unpacklo_epi8 (x, x), hi = _mm_unpackhi_epi8 (x, x) ;
+      _mm_storeu_si128 ((__m128i*) s,      dnaChars128 (_mm_unpacklo_epi16 (lo, lo), a, ac, ag, at)) ;
+      _mm_storeu_si128 ((__m128i*) (s+16), dnaChars128 (_mm_unpackhi_epi16 (lo, lo), a, ac, ag, at)) ;
+      _mm_storeu_si128 ((__m128i*) (s+32), dnaChars128 (_mm_unpacklo_epi16 (hi, hi), a, ac, ag, at)) ;
+      _mm_storeu_si128 ((__m128i*) (s+48), dnaChars128 (_mm_unpackhi_epi16 (hi, hi), a, ac, ag, at)) ;
+    }
+}
+
+/* the AVX2 versions do twice as much per step - the packs work within 128-bit lanes
+   so need a final permute, and unpack widens 8 bytes to 32-bit lanes then replicates
+*/
+
+__attribute__((target("avx2")))
+static inline __m256i dnaCodes256 (__m256i x)
+{
+  __m256i lc = _mm256_or_si256 (x, _mm256_set1_epi8 (0x20)) ;
+  __m256i c  = _mm256_cmpeq_epi8 (lc, _mm256_set1_epi8 ('c')) ;
+  __m256i g  = _mm256_cmpeq_epi8 (lc, _mm256_set1_epi8 ('g')) ;
+  __m256i t  = _mm256_cmpeq_epi8 (lc, _mm256_set1_epi8 ('t')) ;
+  c = _mm256_or_si256 (c, _mm256_cmpeq_epi8 (x, _mm256_set1_epi8 (1))) ;
+  g = _mm256_or_si256 (g, _mm256_cmpeq_epi8 (x, _mm256_set1_epi8 (2))) ;
+  t = _mm256_or_si256 (t, _mm256_cmpeq_epi8 (x, _mm256_set1_epi8 (3))) ;
+  x = _mm256_or_si256 (_mm256_and_si256 (c, _mm256_set1_epi8 (1)),
+		       _mm256_and_si256 (g, _mm256_set1_epi8 (2))) ;
+  x = _mm256_or_si256 (x, _mm256_and_si256 (t, _mm256_set1_epi8 (3))) ;
+  x = _mm256_or_si256 (x, _mm256_srli_epi16 (x, 6)) ;
+  x = _mm256_or_si256 (x, _mm256_srli_epi32 (x, 12)) ;
+  return _mm256_and_si256 (x, _mm256_set1_epi32 (0xff)) ;
+}
+
+__attribute__((target("avx2")))
+static void dnaPackAVX2 (const uint8_t *s, uint8_t *u, int64_t n)
+{
+  __m256i perm = _mm256_setr_epi32 (0, 4, 1, 5, 2, 6, 3, 7) ;
+  for ( ; n >= 32 ; n -= 32, s += 128, u += 32)
+    { __m256i x0 = dnaCodes256 (_mm256_loadu_si256 ((const __m256i*) s)) ;
+      __m256i x1 = dnaCodes256 (_mm256_loadu_si256 ((const __m256i*) (s+32))) ;
+      __m256i x2 = dnaCodes256 (_mm256_loadu_si256 ((const __m256i*) (s+64))) ;
+      __m256i x3 = dnaCodes256 (_mm256_loadu_si256 ((const __m256i*) (s+96))) ;
+      __m256i x  = _mm256_packus_epi16 (_mm256_packs_epi32 (x0, x1), _mm256_packs_epi32 (x2, x3)) ;
+      _mm256_storeu_si256 ((__m256i*) u, _mm256_permutevar8x32_epi32 (x, perm)) ;
+    }
+  dnaPackSSE2 (s, u, n) ;
+}
+
+__attribute__((target("avx2")))
+static void dnaUnpackAVX2 (const uint8_t *u, char *s, int64_t n, const char *alphabet)
+{
+  __m256i a    = _mm256_set1_epi8 (alphabet[0]) ;
+  __m256i ac   = _mm256_xor_si256 (a, _mm256_set1_epi8 (alphabet[1])) ;
+  __m256i ag   = _mm256_xor_si256 (a, _mm256_set1_epi8 (alphabet[2])) ;
+  __m256i at   = _mm256_xor_si256 (a, _mm256_set1_epi8 (alphabet[3])) ;
+  __m256i mask = _mm256_set1_epi32 ((int) 0xc0300c03) ;
+  __m256i one  = _mm256_set1_epi32 (0x40100401) ;
+  __m256i two  = _mm256_set1_epi32 ((int) 0x80200802) ;
+  __m256i rep  = _mm256_set1_epi32 (0x01010101) ;
+  for ( ; n >= 8 ; n -= 8, u += 8, s += 32)
+    { __m256i x = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i*) u)) ;
+      x = _mm256_and_si256 (_mm256_mullo_epi32 (x, rep), mask) ;
+      __m256i y = _mm256_xor_si256 (a, _mm256_and_si256 (ac, _mm256_cmpeq_epi8 (x, one))) ;
+      y = _mm256_xor_si256 (y, _mm256_and_si256 (ag, _mm256_cmpeq_epi8 (x, two))) ;
+      y = _mm256_xor_si256 (y, _mm256_and_si256 (at, _mm256_cmpeq_epi8 (x, mask))) ;
+      _mm256_storeu_si256 ((__m256i*) s, y) ;
+    }
+}
+
+static inline int dnaHasAVX2 (void)
+{
+  static int has = -1 ;		/* a race here is harmless - all threads set the same value */
+  if (has < 0) { __builtin_cpu_init () ; has = __builtin_cpu_supports ("avx2") ? 1 : 0 ; }
+  return has ;
+}
+
+#endif /* x86_64 */
+
+static inline void dnaPack2bit (const char *s, uint8_t *u, int64_t len)
+{
+  int64_t n = len >> 2 ;	/* number of full output bytes */
+  int64_t done = 0 ;
+#if defined(__x86_64__) && defined(__GNUC__)
+  if (n >= 32 && dnaHasAVX2 ())
+    { done = n & ~(int64_t)31 ; dnaPackAVX2 ((const uint8_t*) s, u, done) ; }
+  else if (n >= 16)
+    { done = n & ~(int64_t)15 ; dnaPackSSE2 ((const uint8_t*) s, u, done) ; }
+#endif
+  dnaPackTail ((const uint8_t*) s + 4*done, u + done, len - 4*done) ;
+}
+
+static inline void dnaUnpack2bit (const uint8_t *u, char *s, int64_t len, const char *alphabet)
+{
+  int64_t n = len >> 2 ;
+  int64_t done = 0 ;
+#if defined(__x86_64__) && defined(__GNUC__)
+  if (n >= 8 && dnaHasAVX2 ())
+    { done = n & ~(int64_t)7 ; dnaUnpackAVX2 (u, s, done, alphabet) ; }
+  else if (n >= 16)
+    { done = n & ~(int64_t)15 ; dnaUnpackSSE2 (u, s, done, alphabet) ; }
+#endif
+  dnaUnpackTail (u + done, s + 4*done, len - 4*done, alphabet) ;
+}
+
+#endif /* DNAPACK_DEFINED */
+
+/******************* end of file **************/
@@ -11,6 +11,10 @@
  */
 
 #include "alntools.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 void reportGdb (Gdb *gdb, FILE *f)
 { fprintf (f, "%d seqs %d contigs (%d gaps)", gdb->nSeq, gdb->nCtg, gdb->nGap) ;
@@ -173,6 +177,10 @@ void gdbDestroy (Gdb *gdb)
   newFree (gdb->ctgLen, gdb->maxCtg, I64) ;
   newFree (gdb->ctgSeq, gdb->maxCtg, int) ;
   newFree (gdb->ctgPos, gdb->maxCtg, I64) ;
+  if (gdb->bps)
+    { munmap (gdb->bps, gdb->bpsSize) ;
+      newFree (gdb->ctgBoff, gdb->maxCtg, I64) ;
+    }
 #ifdef GDB_MASK
   if (gdb->maxMask)
     { newFree (gdb->ctgMaskCount, gdb->maxCtg, int) ;
@@ -183,6 +191,70 @@ void gdbDestroy (Gdb *gdb)
   newFree (gdb, 1, Gdb) ;
 }
 
+/********************** direct access to the bases ******************************/
+
+bool gdbOpenBases (Gdb *gdb, char *gdbFileName)
+{
+  if (!gdbFileName) gdbFileName = gdb->seqFileName ;
+  if (!gdbFileName) return false ;
+  int   n = strlen (gdbFileName) ;
+  if (n < 6 || strcmp (gdbFileName + n - 5, ".1gdb")) return false ;
+
+  char *bpsName = new (n + 2, char), *root = strrchr (gdbFileName, '/') ;
+  root = root ? root + 1 : gdbFileName ;
+  sprintf (bpsName, "%.*s.%.*s.bps", (int)(root - gdbFileName), gdbFileName,
+	   (int)(gdbFileName + n - 5 - root), root) ;
+  int fd = open (bpsName, O_RDONLY) ;
+  struct stat st ;
+  if (fd < 0 || fstat (fd, &st))
+    { if (fd >= 0) close (fd) ;
+      newFree (bpsName, n+2, char) ;
+      return false ;
+    }
+
+  int i ;
+  I64 boff = 0 ;
+  gdb->ctgBoff = new (gdb->maxCtg, I64) ;
+  for (i = 0 ; i < gdb->nCtg ; ++i)
+    { gdb->ctgBoff[i] = boff ; boff += (gdb->ctgLen[i] + 3) / 4 ; }
+  if (boff != st.st_size)
+    die ("size %lld of %s does not match %lld bytes for the contigs in %s",
+	 (long long) st.st_size, bpsName, (long long) boff, gdbFileName) ;
+  gdb->bpsSize = st.st_size ;
+  gdb->bps = mmap (0, gdb->bpsSize ? gdb->bpsSize : 1, PROT_READ, MAP_SHARED, fd, 0) ;
+  if (gdb->bps == MAP_FAILED) die ("failed to map %s", bpsName) ;
+  close (fd) ;
+  newFree (bpsName, n+2, char) ;
+  return true ;
+}
+
+char *gdbCtgText (Gdb *gdb, int ctg, I64 start, I64 end, char *s, const char *alphabet)
+{
+  if (!gdb->bps) die ("gdbCtgText called without the bases - call gdbOpenBases() first") ;
+  if (ctg < 0 || ctg >= gdb->nCtg || start < 0 || start > end || end > gdb->ctgLen[ctg])
+    die ("gdbCtgText range %lld..%lld out of bounds for contig %d", 
+	 (long long) start, (long long) end, ctg) ;
+  if (!s) s = new (end - start + 1, char) ;
+  U8   *u = gdbCtgPacked (gdb, ctg) ;
+  char *t = s ;
+  I64   i = start ;
+  for ( ; i < end && (i & 3) ; ++i) *t++ = alphabet[gdbBase (u, i)] ;
+  if (end - i >= 64)		/* 4 bases per byte via a table */
+    { char expand[256][4] ;
+      int  j ;
+      for (j = 0 ; j < 256 ; ++j)
+	{ expand[j][0] = alphabet[j >> 6] ; expand[j][1] = alphabet[(j >> 4) & 3] ;
+	  expand[j][2] = alphabet[(j >> 2) & 3] ; expand[j][3] = alphabet[j & 3] ;
+	}
+      U8 *v = u + (i >> 2), *vEnd = u + (end >> 2) ;
+      while (v < vEnd) { memcpy (t, expand[*v++], 4) ; t += 4 ; }
+      i = end & ~(I64)3 ;
+    }
+  for ( ; i < end ; ++i) *t++ = alphabet[gdbBase (u, i)] ;
+  *t = 0 ;
+  return s ;
+}
+
 /********************** main function for gdbmask ******************************/
 
 #ifdef GDB_MASK
@@ -0,0 +1,387 @@
+/*  File: inflater.h
+ *-------------------------------------------------------------------
+ * Description: threaded gzip and BGZF reading shared by ONElib and seqio
+ *   BGZF files, as made by bgzip, are a series of independent gzip blocks each holding at
+ *   most 64KB, with the compressed block size in a 'BC' extra field.  The file is mapped,
+ *   a table of block offsets is built, and chunks of blocks are inflated ahead of the
+ *   reader by a pool of threads into a ring of slots.  Seeking is a binary search in the
+ *   table.  Plain gzip is inflated ahead of the reader by a single producer thread into
+ *   the same ring, and can only be read sequentially.
+ * Exported functions: inflaterOpen(), inflaterRead(), inflaterSeek(), inflaterPos(), inflaterSize(),
+ *   inflaterClose(), bgzfBlockSize(), bgzfBlocks(), bgzfInflate(), bgzfLe16(), bgzfLe32()
+ * Created: Sat Oct 17 2026
+ *-------------------------------------------------------------------
+ */
+
+#ifndef INFLATER_DEFINED
+#define INFLATER_DEFINED
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+typedef struct InflaterStruct Inflater ;
+
+/* inflaterOpen() returns 0 if path can't be opened or is not gzipped.  A BGZF file is
+     inflated by nThread threads, or 0 for the number of cores up to INFLATE_THREAD_MAX, in
+     chunks of chunkBlocks blocks - small for random access, larger for streaming.
+   inflaterRead() returns the number of bytes read, 0 at the end, or -1 if the data are
+     corrupt.  If buf is 0 the bytes are skipped.
+   inflaterSeek() sets the uncompressed read position.  Plain gzip inflates up to pos, from
+     the start of the file if pos is before the chunk being read, so going back is slow.
+   inflaterSize() is the uncompressed size of a BGZF file, or -1 for plain gzip.
+*/
+
+static inline Inflater *inflaterOpen (const char *path, int nThread, int chunkBlocks) ;
+static inline int64_t inflaterRead (Inflater *inf, char *buf, int64_t n) ;
+static inline bool inflaterSeek (Inflater *inf, int64_t pos) ;
+static inline int64_t inflaterPos (Inflater *inf) ;
+static inline int64_t inflaterSize (Inflater *inf) ;
+static inline void inflaterClose (Inflater *inf) ;
+
+/* bgzfBlockSize() returns 0 if p does not start a complete BGZF block in the left bytes.
+   bgzfBlocks() returns the nBlock+1 compressed block starts of a mapped file, and if uOff
+     is set the uncompressed starts in *uOff, or 0 if any block is not BGZF.
+   bgzfInflate() inflates the block at p of compressed length cLen into out, which must have
+     room for 64KB, returning its length or -1 if it is corrupt.  z must have been set up
+     with inflateInit2 (z, -15).
+*/
+
+static inline uint32_t bgzfBlockSize (const uint8_t *p, uint64_t left) ;
+static inline uint64_t *bgzfBlocks (const uint8_t *map, uint64_t size, int64_t *nBlock, uint64_t **uOff) ;
+static inline int64_t bgzfInflate (z_stream *z, const uint8_t *p, uint64_t cLen, uint8_t *out) ;
+
+/************** the rest of this file is implementation *************/
+
+#define INFLATE_THREAD_MAX   8
+#define INFLATE_SLOTS        4	  /* chunks held per thread */
+#define BGZF_BLOCK_MAX   65536
+#define GZIP_CHUNK     (1<<20)
+
+static inline uint32_t bgzfLe16 (const uint8_t *p) { return p[0] | (p[1] << 8) ; }
+static inline uint32_t bgzfLe32 (const uint8_t *p)
+{ return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24) ; }
+
+static inline uint32_t bgzfBlockSize (const uint8_t *p, uint64_t left)
+{
+  uint32_t xlen, i, size ;
+
+  if (left < 26 || p[0] != 0x1f || p[1] != 0x8b || p[2] != 8 || !(p[3] & 4)) return 0 ;
+  xlen = bgzfLe16 (p+10) ;
+  for (i = 12 ; i + 4 <= 12 + xlen && i + 4 <= left ; i += 4 + bgzfLe16 (p+i+2))
+    if (p[i] == 'B' && p[i+1] == 'C' && bgzfLe16 (p+i+2) == 2)
+      { size = bgzfLe16 (p+i+4) + 1 ;
+	return (size <= left && size >= 12 + xlen + 8) ? size : 0 ;
+      }
+  return 0 ;
+}
+
+static inline uint64_t *bgzfBlocks (const uint8_t *map, uint64_t size, int64_t *nBlock, uint64_t **uOff)
+{
+  uint64_t off = 0, n = 0, nMax = size / BGZF_BLOCK_MAX + 1024, k ;
+  uint64_t *cOff = (uint64_t*) malloc ((nMax+1) * sizeof(uint64_t)) ;
+  uint32_t bsize ;
+
+  while (off < size && (bsize = bgzfBlockSize (map + off, size - off)))
+    { if (n == nMax) { nMax *= 2 ; cOff = (uint64_t*) realloc (cOff, (nMax+1) * sizeof(uint64_t)) ; }
+      cOff[n++] = off ;
+      off += bsize ;
+    }
+  if (off < size || !n) { free (cOff) ; return 0 ; }
+  cOff[n] = off ;
+  *nBlock = n ;
+  if (uOff)			/* the uncompressed size is the last 4 bytes of each block */
+    { *uOff = (uint64_t*) malloc ((n+1) * sizeof(uint64_t)) ;
+      (*uOff)[0] = 0 ;
+      for (k = 0 ; k < n ; ++k) (*uOff)[k+1] = (*uOff)[k] + bgzfLe32 (map + cOff[k+1] - 4) ;
+    }
+  return cOff ;
+}
+
+static inline int64_t bgzfInflate (z_stream *z, const uint8_t *p, uint64_t cLen, uint8_t *out)
+{
+  const uint8_t *end = p + cLen ;
+  uint32_t       isize = bgzfLe32 (end-4) ;
+
+  if (isize > BGZF_BLOCK_MAX) return -1 ;
+  z->next_in   = (uint8_t*) p + 12 + bgzfLe16 (p+10) ;
+  z->avail_in  = (end - 8) - z->next_in ;
+  z->next_out  = out ;
+  z->avail_out = isize ;
+  if (inflateReset (z) != Z_OK || inflate (z, Z_FINISH) != Z_STREAM_END || z->avail_out
+      || crc32 (0, out, isize) != bgzfLe32 (end-8))
+    return -1 ;
+  return isize ;
+}
+
+typedef struct {
+  int64_t  chunk ;		/* chunk claimed for this slot, -1 if none */
+  bool     isDone ;		/* inflated and ready for the reader */
+  char    *buf ;
+  int64_t  len ;		/* -1 if corrupt */
+} InflateSlot ;
+
+struct InflaterStruct {
+  uint8_t        *map ;		/* BGZF: the mapped compressed file */
+  uint64_t        mapSize ;
+  int64_t         nBlock ;
+  uint64_t       *cOff, *uOff ;	/* compressed and uncompressed block starts, [nBlock] is the end */
+  int             chunkBlocks ;
+  gzFile          gz ;		/* plain gzip */
+  int64_t         nChunk ;	/* BGZF: number of chunks, gzip: chunks up to the end, else -1 */
+  int64_t         chunkSize ;	/* buffer size */
+  int             nThread, nSlot ;
+  pthread_t      *thread ;
+  InflateSlot    *slot ;	/* chunk c goes in slot[c % nSlot] */
+  int64_t         next ;	/* next chunk to hand to a thread */
+  int64_t         cur ;		/* chunk the reader is on - threads work in [cur, cur+nSlot) */
+  bool            isStop ;
+  pthread_mutex_t mutex ;
+  pthread_cond_t  isWork, isReady ;
+  char          **spare ;	/* thread scratch buffers, made by the opener */
+  int             nSpare ;
+  char           *rBuf ;	/* the chunk the reader owns */
+  int64_t         rChunk, rLen, rStart ;
+  int64_t         pos ;		/* uncompressed read position */
+} ;
+
+static inline int64_t inflateChunk (Inflater *inf, z_stream *z, int64_t c, char *buf)
+{
+  int64_t b, bEnd = (c+1) * inf->chunkBlocks, len = 0, k ;
+
+  if (inf->gz)
+    { int n = gzread (inf->gz, buf, GZIP_CHUNK) ;
+      return (n < 0) ? -1 : n ;
+    }
+  if (bEnd > inf->nBlock) bEnd = inf->nBlock ;
+  for (b = c * inf->chunkBlocks ; b < bEnd ; ++b)
+    { k = bgzfInflate (z, inf->map + inf->cOff[b], inf->cOff[b+1] - inf->cOff[b], (uint8_t*) buf + len) ;
+      if (k < 0 || k != (int64_t) (inf->uOff[b+1] - inf->uOff[b])) return -1 ;
+      len += k ;
+    }
+  return len ;
+}
+
+static void *inflaterThread (void *arg)
+{
+  Inflater    *inf = (Inflater*) arg ;
+  InflateSlot *s ;
+  z_stream     z ;
+  char        *buf, *t ;
+  int64_t      c, len ;
+  bool         isZ ;
+
+  memset (&z, 0, sizeof(z_stream)) ;
+  isZ = !inf->gz && inflateInit2 (&z, -15) == Z_OK ;
+
+  pthread_mutex_lock (&inf->mutex) ;
+  buf = inf->spare[--inf->nSpare] ;
+  while (!inf->isStop)
+    { for (c = (inf->next > inf->cur) ? inf->next : inf->cur ;
+	   (inf->nChunk < 0 || c < inf->nChunk) && c < inf->cur + inf->nSlot ; ++c)
+	if (inf->slot[c % inf->nSlot].chunk != c) break ; /* not yet claimed */
+      inf->next = c ;
+      if ((inf->nChunk >= 0 && c >= inf->nChunk) || c >= inf->cur + inf->nSlot)
+	{ pthread_cond_wait (&inf->isWork, &inf->mutex) ; /* nothing to do until the reader moves */
+	  continue ;
+	}
+      s = &inf->slot[c % inf->nSlot] ;
+      s->chunk = c ; s->isDone = false ; inf->next = c+1 ;
+      pthread_mutex_unlock (&inf->mutex) ;
+      len = (inf->gz || isZ) ? inflateChunk (inf, &z, c, buf) : -1 ;
+      pthread_mutex_lock (&inf->mutex) ;
+      if (inf->gz && len < GZIP_CHUNK) inf->nChunk = c+1 ; /* end of file, or an error */
+      if (s->chunk == c)	/* else the reader jumped away and the slot was reclaimed */
+	{ t = s->buf ; s->buf = buf ; buf = t ;
+	  s->len = len ; s->isDone = true ;
+	  pthread_cond_broadcast (&inf->isReady) ;
+	}
+    }
+  inf->spare[inf->nSpare++] = buf ;
+  pthread_mutex_unlock (&inf->mutex) ;
+
+  if (isZ) inflateEnd (&z) ;
+  return 0 ;
+}
+
+static inline Inflater *inflaterOpen (const char *path, int nThread, int chunkBlocks)
+{
+  Inflater   *inf ;
+  struct stat st ;
+  uint8_t     magic[2], *map ;
+  int         fd = open (path, O_RDONLY), i ;
+
+  if (fd < 0) return 0 ;
+  if (fstat (fd, &st) || !S_ISREG(st.st_mode) || read (fd, magic, 2) != 2
+      || magic[0] != 0x1f || magic[1] != 0x8b)
+    { close (fd) ; return 0 ; }
+
+  inf = (Inflater*) calloc (1, sizeof(Inflater)) ;
+  map = (uint8_t*) mmap (0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) ;
+  if (map != MAP_FAILED && (inf->cOff = bgzfBlocks (map, st.st_size, &inf->nBlock, &inf->uOff)))
+    { close (fd) ;		/* the mapping stays valid */
+      inf->map = map ;
+      inf->mapSize = st.st_size ;
+      inf->chunkBlocks = (chunkBlocks > 0) ? chunkBlocks : 1 ;
+      inf->nChunk = (inf->nBlock + inf->chunkBlocks - 1) / inf->chunkBlocks ;
+      inf->chunkSize = (int64_t) inf->chunkBlocks * BGZF_BLOCK_MAX ;
+      if (nThread <= 0)
+	{ nThread = sysconf (_SC_NPROCESSORS_ONLN) ;
+	  if (nThread > INFLATE_THREAD_MAX) nThread = INFLATE_THREAD_MAX ;
+	  if (nThread < 1) nThread = 1 ;
+	}
+      inf->nThread = nThread ;
+      madvise (map, st.st_size, MADV_SEQUENTIAL) ;
+    }
+  else				/* plain gzip, or some block is not BGZF */
+    { if (map != MAP_FAILED) munmap (map, st.st_size) ;
+      if (lseek (fd, 0, SEEK_SET) != 0 || !(inf->gz = gzdopen (fd, "r")))
+	{ close (fd) ; free (inf) ; return 0 ; }
+      gzbuffer (inf->gz, 1 << 17) ;
+      inf->nChunk = -1 ;
+      inf->chunkSize = GZIP_CHUNK ;
+      inf->nThread = 1 ;	/* must be 1, to read the chunks in order */
+    }
+
+  inf->nSlot = INFLATE_SLOTS * inf->nThread ;
+  inf->slot = (InflateSlot*) calloc (inf->nSlot, sizeof(InflateSlot)) ;
+  for (i = 0 ; i < inf->nSlot ; ++i) /* allocate here so the threads don't */
+    { inf->slot[i].chunk = -1 ;
+      inf->slot[i].buf = (char*) malloc (inf->chunkSize) ;
+    }
+  inf->spare = (char**) malloc (inf->nThread * sizeof(char*)) ;
+  for (inf->nSpare = 0 ; inf->nSpare < inf->nThread ; ++inf->nSpare)
+    inf->spare[inf->nSpare] = (char*) malloc (inf->chunkSize) ;
+  inf->rBuf = (char*) malloc (inf->chunkSize) ;
+  inf->rChunk = -1 ;
+  pthread_mutex_init (&inf->mutex, 0) ;
+  pthread_cond_init (&inf->isWork, 0) ;
+  pthread_cond_init (&inf->isReady, 0) ;
+  inf->thread = (pthread_t*) malloc (inf->nThread * sizeof(pthread_t)) ;
+  for (i = 0 ; i < inf->nThread ; ++i)
+    pthread_create (&inf->thread[i], 0, inflaterThread, inf) ;
+  return inf ;
+}
+
+static inline void inflaterStop (Inflater *inf)
+{
+  int i ;
+
+  pthread_mutex_lock (&inf->mutex) ;
+  inf->isStop = true ;
+  pthread_cond_broadcast (&inf->isWork) ;
+  pthread_mutex_unlock (&inf->mutex) ;
+  for (i = 0 ; i < inf->nThread ; ++i) pthread_join (inf->thread[i], 0) ;
+}
+
+static inline bool inflaterRewind (Inflater *inf) /* plain gzip: back to the start */
+{
+  int i ;
+
+  inflaterStop (inf) ;
+  if (gzrewind (inf->gz) != 0) return false ;
+  for (i = 0 ; i < inf->nSlot ; ++i) { inf->slot[i].chunk = -1 ; inf->slot[i].isDone = false ; }
+  inf->next = inf->cur = 0 ;
+  inf->nChunk = -1 ;
+  inf->isStop = false ;
+  inf->rChunk = -1 ; inf->rLen = inf->rStart = 0 ;
+  inf->pos = 0 ;
+  for (i = 0 ; i < inf->nThread ; ++i)
+    pthread_create (&inf->thread[i], 0, inflaterThread, inf) ;
+  return true ;
+}
+
+static inline bool inflaterLoad (Inflater *inf, int64_t c) /* swap chunk c into rBuf */
+{
+  InflateSlot *s = &inf->slot[c % inf->nSlot] ;
+  char        *t ;
+
+  pthread_mutex_lock (&inf->mutex) ;
+  inf->cur = c ;
+  if (s->chunk != c && inf->next > c) inf->next = c ; /* a jump back - restart from here */
+  pthread_cond_broadcast (&inf->isWork) ;
+  while (s->chunk != c || !s->isDone)
+    pthread_cond_wait (&inf->isReady, &inf->mutex) ;
+  t = s->buf ; s->buf = inf->rBuf ; inf->rBuf = t ;
+  inf->rLen = s->len ; inf->rChunk = c ;
+  inf->rStart = inf->gz ? c * GZIP_CHUNK : (int64_t) inf->uOff[c * inf->chunkBlocks] ;
+  s->chunk = -1 ; s->isDone = false ;
+  pthread_cond_broadcast (&inf->isWork) ; /* the slot is free again */
+  pthread_mutex_unlock (&inf->mutex) ;
+  return inf->rLen >= 0 ;
+}
+
+static inline int64_t inflaterRead (Inflater *inf, char *buf, int64_t size)
+{
+  int64_t n = 0, k, lo, hi, mid ;
+
+  while (n < size)
+    { if (inf->rChunk < 0 || inf->pos < inf->rStart || inf->pos >= inf->rStart + inf->rLen)
+	{ if (inf->gz)		/* reading is sequential, so pos is at the end of rBuf */
+	    { if (inf->rChunk >= 0 && inf->rLen < GZIP_CHUNK) break ; /* the last chunk */
+	      k = inf->rChunk + 1 ;
+	    }
+	  else
+	    { if (inf->pos >= (int64_t) inf->uOff[inf->nBlock]) break ;
+	      lo = 0 ; hi = inf->nBlock - 1 ; /* find the last block starting at or before pos */
+	      while (lo < hi)
+		{ mid = (lo + hi + 1) / 2 ;
+		  if ((int64_t) inf->uOff[mid] <= inf->pos) lo = mid ; else hi = mid - 1 ;
+		}
+	      k = lo / inf->chunkBlocks ;
+	    }
+	  if (!inflaterLoad (inf, k)) return -1 ;
+	  if (inf->pos >= inf->rStart + inf->rLen) break ; /* an empty last chunk */
+	}
+      k = inf->rStart + inf->rLen - inf->pos ;
+      if (k > size - n) k = size - n ;
+      if (buf) memcpy (buf + n, inf->rBuf + (inf->pos - inf->rStart), k) ;
+      n += k ;
+      inf->pos += k ;
+    }
+  return n ;
+}
+
+static inline bool inflaterSeek (Inflater *inf, int64_t pos)
+{
+  int64_t skip = pos - inf->pos ;
+
+  if (pos < 0) return false ;
+  if (inf->gz && skip > 0)
+    return inflaterRead (inf, 0, skip) == skip ;
+  if (inf->gz && pos < inf->rStart) /* before the chunk we have */
+    { if (!inflaterRewind (inf)) return false ;
+      return inflaterRead (inf, 0, pos) == pos ;
+    }
+  inf->pos = pos ;
+  return true ;
+}
+
+static inline int64_t inflaterPos (Inflater *inf) { return inf->pos ; }
+
+static inline int64_t inflaterSize (Inflater *inf) { return inf->gz ? -1 : (int64_t) inf->uOff[inf->nBlock] ; }
+
+static inline void inflaterClose (Inflater *inf)
+{
+  int i ;
+
+  inflaterStop (inf) ;
+  pthread_mutex_destroy (&inf->mutex) ;
+  pthread_cond_destroy (&inf->isWork) ;
+  pthread_cond_destroy (&inf->isReady) ;
+  for (i = 0 ; i < inf->nSlot ; ++i) free (inf->slot[i].buf) ;
+  for (i = 0 ; i < inf->nSpare ; ++i) free (inf->spare[i]) ;
+  free (inf->slot) ; free (inf->spare) ; free (inf->thread) ; free (inf->rBuf) ;
+  if (inf->gz) gzclose (inf->gz) ;
+  if (inf->map) { munmap (inf->map, inf->mapSize) ; free (inf->cOff) ; free (inf->uOff) ; }
+  free (inf) ;
+}
+
+#endif /* INFLATER_DEFINED */
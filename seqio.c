@@ -12,8 +12,15 @@
  */
 
 #include "seqio.h"
+#include "dnapack.h"
+#include "inflater.h"
+#include "dict.h"
+#include <ctype.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #ifdef ONEIO
 #include "ONElib.h"
@@ -28,17 +35,349 @@ void bamFileClose (SeqIO *si) ;
 // global
 char* seqIOtypeName[] = { "unknown", "fasta", "fastq", "binary", "onecode", "bam" } ;
 
+/********** threaded decompression for seqIOopenRead() ***********/
+
+/* Gzipped input is inflated ahead of the parser by other threads, using the Inflater in
+   inflater.h that ONElib also uses: BGZF blocks by a pool of threads, plain gzip by a
+   single producer thread.
+*/
+
+#define BGZF_JOB_BLOCKS     16	  /* per chunk, at most 64KB each */
+
+/********** threaded BGZF compression for seqIOopenWrite() ***********/
+
+/* Gzipped output is written as BGZF, so it can be read in parallel and indexed.  The
+   writer fills a ring of slots with chunks of up to DEFLATE_JOB_BLOCKS blocks, a pool of
+   threads deflates them, and the writer writes the compressed chunks to the file in
+   order before reusing their slots.
+*/
+
+#define DEFLATE_THREAD_MAX   8
+#define DEFLATE_SLOTS        4	  /* per thread */
+#define DEFLATE_JOB_BLOCKS  16
+#define BGZF_BLOCK_DATA  0xff00	  /* as bgzip - leaves room for incompressible data */
+
+typedef struct {
+  char *in, *out ;
+  U64   inLen, outLen ;
+  I64   job ;
+  bool  isDone ;
+} DeflateSlot ;
+
+typedef struct {
+  int          nThread, nSlot ;
+  pthread_t   *thread ;
+  pthread_mutex_t mutex ;
+  pthread_cond_t  cond ;
+  DeflateSlot *slot ;
+  I64          nJob ;		/* jobs handed to the threads - job nJob is being filled */
+  I64          next ;		/* next job to claim */
+  I64          nWritten ;	/* jobs written to the file */
+  bool         isStop ;
+  int          fd ;
+} Deflater ;
+
+static U32 bgzfBlockDeflate (z_stream *z, z_stream *z0, U8 *in, U32 len, U8 *out)
+{
+  static U8 header[18] = { 0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0, 0, 0 } ;
+  memcpy (out, header, 18) ;
+  z->next_in = in ; z->avail_in = len ;
+  z->next_out = out + 18 ; z->avail_out = 65536 - 26 ;
+  if (deflateReset (z) != Z_OK || deflate (z, Z_FINISH) != Z_STREAM_END)
+    { z = z0 ;			/* incompressible, so store it */
+      z->next_in = in ; z->avail_in = len ;
+      z->next_out = out + 18 ; z->avail_out = 65536 - 26 ;
+      if (deflateReset (z) != Z_OK || deflate (z, Z_FINISH) != Z_STREAM_END)
+	die ("failed to deflate BGZF block") ;
+    }
+  U32 size = 18 + z->total_out + 8, crc = crc32 (0, in, len) ;
+  out[16] = (size-1) & 0xff ; out[17] = (size-1) >> 8 ;
+  U8 *p = out + size - 8 ;
+  p[0] = crc ; p[1] = crc >> 8 ; p[2] = crc >> 16 ; p[3] = crc >> 24 ;
+  p[4] = len ; p[5] = len >> 8 ; p[6] = len >> 16 ; p[7] = len >> 24 ;
+  return size ;
+}
+
+static void *deflateThread (void *arg)
+{
+  Deflater *def = (Deflater*) arg ;
+  z_stream  z, z0 ;
+  memset (&z, 0, sizeof(z)) ; memset (&z0, 0, sizeof(z0)) ;
+  if (deflateInit2 (&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK
+      || deflateInit2 (&z0, 0, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    die ("failed to initialise deflate") ;
+
+  pthread_mutex_lock (&def->mutex) ;
+  while (true)
+    { while (!def->isStop && def->next >= def->nJob)
+	pthread_cond_wait (&def->cond, &def->mutex) ;
+      if (def->next >= def->nJob) break ; /* stopped and nothing left to do */
+      DeflateSlot *s = &def->slot[def->next++ % def->nSlot] ;
+      pthread_mutex_unlock (&def->mutex) ;
+      U64 i ;
+      s->outLen = 0 ;
+      for (i = 0 ; i < s->inLen ; i += BGZF_BLOCK_DATA)
+	s->outLen += bgzfBlockDeflate (&z, &z0, (U8*) s->in + i,
+				       (s->inLen - i < BGZF_BLOCK_DATA) ? s->inLen - i : BGZF_BLOCK_DATA,
+				       (U8*) s->out + s->outLen) ;
+      pthread_mutex_lock (&def->mutex) ;
+      s->isDone = true ;
+      pthread_cond_broadcast (&def->cond) ;
+    }
+  pthread_mutex_unlock (&def->mutex) ;
+
+  deflateEnd (&z) ; deflateEnd (&z0) ;
+  return 0 ;
+}
+
+static Deflater *deflaterOpen (int fd)
+{
+  Deflater *def = new0 (1, Deflater) ;
+  def->fd = fd ;
+  long nProc = sysconf (_SC_NPROCESSORS_ONLN) ;
+  def->nThread = (nProc < 1) ? 1 : (nProc > DEFLATE_THREAD_MAX) ? DEFLATE_THREAD_MAX : nProc ;
+  def->nSlot = DEFLATE_SLOTS * def->nThread ;
+  def->slot = new0 (def->nSlot, DeflateSlot) ;
+  int i ;
+  for (i = 0 ; i < def->nSlot ; ++i)
+    { def->slot[i].in = new (DEFLATE_JOB_BLOCKS*BGZF_BLOCK_DATA, char) ;
+      def->slot[i].out = new (DEFLATE_JOB_BLOCKS*65536, char) ;
+      def->slot[i].job = -1 ;
+    }
+  pthread_mutex_init (&def->mutex, 0) ;
+  pthread_cond_init (&def->cond, 0) ;
+  def->thread = new (def->nThread, pthread_t) ;
+  for (i = 0 ; i < def->nThread ; ++i)
+    pthread_create (&def->thread[i], 0, deflateThread, def) ;
+  return def ;
+}
+
+static void deflaterFlushTo (Deflater *def, I64 job) /* write all jobs before job */
+{
+  for ( ; def->nWritten < job ; ++def->nWritten)
+    { DeflateSlot *s = &def->slot[def->nWritten % def->nSlot] ;
+      pthread_mutex_lock (&def->mutex) ;
+      while (!s->isDone) pthread_cond_wait (&def->cond, &def->mutex) ;
+      pthread_mutex_unlock (&def->mutex) ;
+      if (write (def->fd, s->out, s->outLen) != (ssize_t) s->outLen)
+	die ("seqio write error writing %llu compressed bytes", s->outLen) ;
+    }
+}
+
+static void deflaterSubmit (Deflater *def)
+{
+  DeflateSlot *s = &def->slot[def->nJob % def->nSlot] ;
+  pthread_mutex_lock (&def->mutex) ;
+  s->isDone = false ;
+  ++def->nJob ;
+  pthread_cond_broadcast (&def->cond) ;
+  pthread_mutex_unlock (&def->mutex) ;
+}
+
+static void deflaterWrite (Deflater *def, char *buf, U64 n)
+{
+  while (n)
+    { DeflateSlot *s = &def->slot[def->nJob % def->nSlot] ;
+      if (s->job != def->nJob)	/* starting to fill this slot - first write out its last job */
+	{ deflaterFlushTo (def, def->nJob - def->nSlot + 1) ;
+	  s->job = def->nJob ; s->inLen = 0 ;
+	}
+      U64 k = DEFLATE_JOB_BLOCKS*BGZF_BLOCK_DATA - s->inLen ;
+      if (k > n) k = n ;
+      memcpy (s->in + s->inLen, buf, k) ;
+      s->inLen += k ; buf += k ; n -= k ;
+      if (s->inLen == DEFLATE_JOB_BLOCKS*BGZF_BLOCK_DATA) deflaterSubmit (def) ;
+    }
+}
+
+static void deflaterClose (Deflater *def)
+{
+  static U8 eofBlock[28] = { 0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0,
+			     0x1b, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0 } ;
+  DeflateSlot *s = &def->slot[def->nJob % def->nSlot] ;
+  if (s->job == def->nJob && s->inLen) deflaterSubmit (def) ;
+  pthread_mutex_lock (&def->mutex) ;
+  def->isStop = true ;		/* the threads finish the jobs they have been given */
+  pthread_cond_broadcast (&def->cond) ;
+  pthread_mutex_unlock (&def->mutex) ;
+  deflaterFlushTo (def, def->nJob) ;
+  if (write (def->fd, eofBlock, 28) != 28) die ("seqio write error writing BGZF end of file") ;
+  int i ;
+  for (i = 0 ; i < def->nThread ; ++i) pthread_join (def->thread[i], 0) ;
+  for (i = 0 ; i < def->nSlot ; ++i) { free (def->slot[i].in) ; free (def->slot[i].out) ; }
+  free (def->slot) ; free (def->thread) ;
+  pthread_mutex_destroy (&def->mutex) ;
+  pthread_cond_destroy (&def->cond) ;
+  close (def->fd) ;
+  free (def) ;
+}
+
+static U64 bufRead (SeqIO *si, char *buf, U64 n) /* all reads of the sequence data come here */
+{
+  if (si->inflater)
+    { I64 k = inflaterRead ((Inflater*) si->inflater, buf, n) ;
+      if (k < 0) die ("corrupt gzip data") ;
+      return k ;
+    }
+  int k = gzread (si->gzf, buf, n) ;
+  return (k > 0) ? k : 0 ;
+}
+
+static void bufClose (SeqIO *si) /* close the data stream, e.g. to reopen as another type */
+{
+  if (si->inflater) { inflaterClose ((Inflater*) si->inflater) ; si->inflater = 0 ; }
+  if (si->deflater) { deflaterClose ((Deflater*) si->deflater) ; si->deflater = 0 ; }
+  if (si->gzf) { gzclose (si->gzf) ; si->gzf = 0 ; }
+}
+
+
+/********** SIMD scanning and conversion of FASTA sequence ***********/
+
+/* The sequence part of a FASTA record is scanned for the '>' that starts the next record
+   with compare masks, counting newlines on the way, and converted with a table lookup
+   by pshufb that drops the entries convert maps to < 0 (newlines etc.).  Any convert
+   table with entries < 128 can be used.  The lookup tables belong to the SeqIO.
+*/
+
+typedef struct {
+  U8 lut[8][16] ;		/* convert[c]+1 at [c>>4][c&0xf], 0 to drop */
+  U8 pack[256][8] ;		/* shuffles to left-pack 8 bytes given the mask of those kept */
+} FastaConv ;
+
+static FastaConv *fastaConvCreate (int *convert)
+{
+#if defined(__x86_64__) && defined(__GNUC__)
+  int i, j, k ;
+  __builtin_cpu_init () ;
+  if (!convert || !__builtin_cpu_supports ("ssse3")) return 0 ;
+  for (i = 0 ; i < 128 ; ++i) if (convert[i] > 127) return 0 ;
+  FastaConv *fc = new0 (1, FastaConv) ;
+  for (i = 0 ; i < 128 ; ++i) fc->lut[i >> 4][i & 0xf] = (convert[i] < 0) ? 0 : convert[i] + 1 ;
+  for (i = 0 ; i < 256 ; ++i)
+    for (j = 0, k = 0 ; j < 8 ; ++j) if (i & (1 << j)) fc->pack[i][k++] = j ;
+  return fc ;
+#else
+  return 0 ;
+#endif
+}
+
+static inline U64 fastaScanTail (char *s, U64 n, U64 *nLine) /* offset of first '>', else n */
+{
+  U64 i ;
+  for (i = 0 ; i < n && s[i] != '>' ; ++i) if (s[i] == '\n') ++*nLine ;
+  return i ;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+
+static U64 fastaScanSSE2 (char *s, U64 n, U64 *nLine)
+{
+  __m128i gt = _mm_set1_epi8 ('>'), nl = _mm_set1_epi8 ('\n') ;
+  U64 i ;
+  for (i = 0 ; i + 16 <= n ; i += 16)
+    { __m128i x = _mm_loadu_si128 ((const __m128i*)(s + i)) ;
+      U32 mNl = _mm_movemask_epi8 (_mm_cmpeq_epi8 (x, nl)) ;
+      U32 mGt = _mm_movemask_epi8 (_mm_cmpeq_epi8 (x, gt)) ;
+      if (mGt)
+	{ U32 k = __builtin_ctz (mGt) ;
+	  *nLine += __builtin_popcount (mNl & ((1u << k) - 1)) ;
+	  return i + k ;
+	}
+      *nLine += __builtin_popcount (mNl) ;
+    }
+  return i + fastaScanTail (s + i, n - i, nLine) ;
+}
+
+__attribute__((target("avx2")))
+static U64 fastaScanAVX2 (char *s, U64 n, U64 *nLine)
+{
+  __m256i gt = _mm256_set1_epi8 ('>'), nl = _mm256_set1_epi8 ('\n') ;
+  U64 i ;
+  for (i = 0 ; i + 32 <= n ; i += 32)
+    { __m256i x = _mm256_loadu_si256 ((const __m256i*)(s + i)) ;
+      U32 mNl = _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (x, nl)) ;
+      U32 mGt = _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (x, gt)) ;
+      if (mGt)
+	{ U32 k = __builtin_ctz (mGt) ;
+	  *nLine += __builtin_popcount (mNl & (U32)((1ull << k) - 1)) ;
+	  return i + k ;
+	}
+      *nLine += __builtin_popcount (mNl) ;
+    }
+  return i + fastaScanSSE2 (s + i, n - i, nLine) ;
+}
+
+__attribute__((target("ssse3")))
+static U64 fastaConvertSSSE3 (FastaConv *fc, char *s, U64 n, char *t) /* t <= s is OK */
+{
+  __m128i lo4 = _mm_set1_epi8 (0xf), one = _mm_set1_epi8 (1), zero = _mm_setzero_si128 () ;
+  __m128i lut[8] ;
+  char *t0 = t ;
+  U64 i ;
+  int h ;
+  for (h = 0 ; h < 8 ; ++h) lut[h] = _mm_loadu_si128 ((const __m128i*) fc->lut[h]) ;
+  for (i = 0 ; i + 16 <= n ; i += 16)
+    { __m128i x = _mm_loadu_si128 ((const __m128i*)(s + i)) ;
+      __m128i lo = _mm_and_si128 (x, lo4) ;
+      __m128i hi = _mm_and_si128 (_mm_srli_epi16 (x, 4), lo4) ; /* bytes >= 128 match no h */
+      __m128i y = zero ;
+      for (h = 0 ; h < 8 ; ++h)
+	y = _mm_or_si128 (y, _mm_and_si128 (_mm_cmpeq_epi8 (hi, _mm_set1_epi8 (h)),
+					    _mm_shuffle_epi8 (lut[h], lo))) ;
+      U32 keep = ~_mm_movemask_epi8 (_mm_cmpeq_epi8 (y, zero)) & 0xffff ;
+      y = _mm_sub_epi8 (y, one) ;
+      if (keep == 0xffff)	/* the usual case inside a line */
+	{ _mm_storeu_si128 ((__m128i*) t, y) ; t += 16 ; continue ; }
+      U32 k0 = keep & 0xff, k1 = keep >> 8 ;	/* both stores stay within the 16 bytes read */
+      _mm_storel_epi64 ((__m128i*) t,
+			_mm_shuffle_epi8 (y, _mm_loadl_epi64 ((const __m128i*) fc->pack[k0]))) ;
+      t += __builtin_popcount (k0) ;
+      _mm_storel_epi64 ((__m128i*) t,
+			_mm_shuffle_epi8 (_mm_srli_si128 (y, 8),
+					  _mm_loadl_epi64 ((const __m128i*) fc->pack[k1]))) ;
+      t += __builtin_popcount (k1) ;
+    }
+  for ( ; i < n ; ++i)
+    { U8 c = s[i] ;
+      if (c < 128 && fc->lut[c >> 4][c & 0xf]) *t++ = fc->lut[c >> 4][c & 0xf] - 1 ;
+    }
+  return t - t0 ;
+}
+
+#endif /* x86_64 */
+
+static inline U64 fastaScan (char *s, U64 n, U64 *nLine)
+{
+  *nLine = 0 ;
+#if defined(__x86_64__) && defined(__GNUC__)
+  if (dnaHasAVX2 ()) return fastaScanAVX2 (s, n, nLine) ;
+  return fastaScanSSE2 (s, n, nLine) ;
+#else
+  return fastaScanTail (s, n, nLine) ;
+#endif
+}
+
+static inline U64 fastaConvert (SeqIO *si, char *s, U64 n) /* in place, returns new length */
+{
+#if defined(__x86_64__) && defined(__GNUC__)
+  if (si->fastaConv) return fastaConvertSSSE3 ((FastaConv*) si->fastaConv, s, n, s) ;
+#endif
+  char *t = s, *e = s + n ;
+  while (s < e) if ((*t++ = si->convert[(int)*s++]) < 0) --t ;
+  return t - (e - n) ;
+}
+
 SeqIO *seqIOopenRead (char *filename, int* convert, bool isQual)
 {
   SeqIO *si = new0 (1, SeqIO) ;
   if (!strcmp (filename, "-")) si->gzf = gzdopen (fileno (stdin), "r") ;
-  else si->gzf = gzopen (filename, "r") ;
-  if (!si->gzf) { free(si) ; return 0 ; }
+  else if (!(si->inflater = inflaterOpen (filename, 0, BGZF_JOB_BLOCKS))) si->gzf = gzopen (filename, "r") ;
+  if (!si->gzf && !si->inflater) { free(si) ; return 0 ; }
   si->bufSize = 1<<24 ; // 16 MB
   si->b = si->buf = new (si->bufSize, char) ;
   si->convert = convert ;
   si->isQual = isQual ;
-  si->nb = gzread (si->gzf, si->buf, si->bufSize) ;
+  si->nb = bufRead (si, si->buf, si->bufSize) ;
   if (!si->nb)
     { fprintf (stderr, "sequence file %s unreadable or empty\n", filename) ;
       seqIOclose (si) ;
@@ -48,6 +387,7 @@ SeqIO *seqIOopenRead (char *filename, int* convert, bool isQual)
   if (*si->buf == '>')
     { si->type = FASTA ; si->isQual = false ;
       if (!si->convert) si->convert = dna2textAmbigConv ; /* default: need to remove whitespace */
+      si->fastaConv = fastaConvCreate (si->convert) ;
     }
   else if (*si->buf == '@')
     {
@@ -58,7 +398,7 @@ SeqIO *seqIOopenRead (char *filename, int* convert, bool isQual)
 	    (si->buf[1] == 'R' && si->buf[2] == 'G') ||
 	    (si->buf[1] == 'P' && si->buf[2] == 'G') ||
 	    (si->buf[1] == 'C' && si->buf[2] == 'O'))) // then almost certainly a SAM file
-	{ gzclose (si->gzf) ; si->gzf = 0 ;
+	{ bufClose (si) ;
 	  if (!bamFileOpenRead (filename, si))
 	    { fprintf (stderr, "failed to open file %s as SAM/BAM/CRAM\n", filename) ;
 	      seqIOclose (si) ;
@@ -95,13 +435,13 @@ SeqIO *seqIOopenRead (char *filename, int* convert, bool isQual)
 	  { maxBufSize = ((maxBufSize >> 20) + 1) << 20 ; /* so a clean number of megabytes */
 	    char *newBuf = new (maxBufSize, char) ; memcpy (newBuf, si->b, si->nb) ;
 	    si->b = si->buf = newBuf ; si->bufSize = maxBufSize ;
-	    si->nb += gzread (si->gzf, si->b + si->nb, si->bufSize - si->nb) ;
+	    si->nb += bufRead (si, si->b + si->nb, si->bufSize - si->nb) ;
 	  }
       }
     }
 #ifdef ONEIO
   else if (*si->buf == '1')
-    { gzclose (si->gzf) ; si->gzf = 0 ;
+    { bufClose (si) ;
       OneFile *vf = oneFileOpenRead (filename, 0, "seq", 1) ;
       if (!vf)
 	{ fprintf (stderr, "failed to open ONE seq file %s\n", filename) ;
@@ -126,7 +466,7 @@ SeqIO *seqIOopenRead (char *filename, int* convert, bool isQual)
 #endif
 #ifdef BAMIO
   else
-    { gzclose (si->gzf) ; si->gzf = 0 ;
+    { bufClose (si) ;
       if (!bamFileOpenRead (filename, si))
 	{ fprintf (stderr, "failed to open file %s as SAM/BAM/CRAM\n", filename) ;
 	  seqIOclose (si) ;
@@ -144,6 +484,314 @@ SeqIO *seqIOopenRead (char *filename, int* convert, bool isQual)
   return si ;
 }
 
+/*********************** indexed random access ***********************/
+
+/* The index is the samtools .fai, with a line "name len offset lineBases lineWidth" per
+   sequence, offsets being in the uncompressed file.  For BGZF there is also the .gzi,
+   with the number of blocks after the first then a (compressed, uncompressed) offset
+   pair for each.  Both are made on first use if absent or older than the file.
+*/
+
+typedef struct {
+  U64 len, off, lineBases, lineWidth ;
+} FaiEntry ;
+
+typedef struct {
+  DICT     *dict ;
+  FaiEntry *fai ;
+  int       fd ;		/* plain FASTA */
+  U8       *map ;		/* BGZF */
+  U64       mapSize ;
+  int64_t   nBlock ;
+  uint64_t *cOff, *uOff ;	/* nBlock+1 block starts in the compressed and uncompressed file, */
+				/* as from bgzfBlocks() */
+  z_stream  z ;
+  char     *block ;		/* the last block inflated */
+  I64       blockNum ;
+} SeqIndex ;
+
+static bool isIndexCurrent (char *indexName, struct stat *st)
+{
+  struct stat ist ;
+  return !stat (indexName, &ist) && ist.st_mtime >= st->st_mtime ;
+}
+
+static void faiAdd (SeqIndex *sx, Array name, FaiEntry *e, U64 *nMax)
+{
+  U32 i ;
+  array(name, arrayMax(name), char) = 0 ; --arrayMax(name) ;
+  if (!dictAdd (sx->dict, arrp(name, 0, char), &i))
+    die ("duplicate sequence name %s in FASTA file", arrp(name, 0, char)) ;
+  if (i >= *nMax) { sx->fai = newResize (sx->fai, *nMax, 2 * *nMax, FaiEntry) ; *nMax *= 2 ; }
+  sx->fai[i] = *e ;
+}
+
+static void faiBuild (SeqIndex *sx, char *filename)
+{
+  SeqIO in ;			/* only used to stream through bufRead() */
+  memset (&in, 0, sizeof(SeqIO)) ;
+  if (!(in.inflater = inflaterOpen (filename, 0, BGZF_JOB_BLOCKS)) && !(in.gzf = gzopen (filename, "r")))
+    die ("failed to open %s to index it", filename) ;
+
+  U64 bufSize = 1 << 24, n, pos = 0, lineLen = 0, nMax = 1024 ;
+  char *buf = new (bufSize, char), last = 0 ;
+  Array name = arrayCreate (256, char) ;
+  FaiEntry e ;
+  bool isStart = true, isHeader = false, isName = false, isSeq = false, isShort = false ;
+  sx->fai = new (nMax, FaiEntry) ;
+  while ((n = bufRead (&in, buf, bufSize)))
+    { char *p = buf, *end = buf + n ;
+      while (p < end)
+	{ if (isStart)
+	    { isStart = false ;
+	      if (*p == '>')
+		{ if (isSeq) faiAdd (sx, name, &e, &nMax) ;
+		  arrayMax(name) = 0 ; isHeader = isName = true ; isSeq = false ;
+		  ++p ; continue ;
+		}
+	      if (!isSeq) die ("FASTA file %s does not start with >", filename) ;
+	      lineLen = 0 ;
+	    }
+	  char *q = memchr (p, '\n', end - p) ;
+	  U64 k = q ? q - p : end - p ;
+	  if (isHeader)
+	    { while (isName && k && !isspace(*p))
+		{ array(name, arrayMax(name), char) = *p++ ; --k ; }
+	      if (k) isName = false ;
+	    }
+	  else if (k)
+	    { lineLen += k ; last = p[k-1] ; }
+	  p += k ;
+	  if (!q) continue ;
+	  ++p ; isStart = true ;
+	  if (isHeader)
+	    { if (!arrayMax(name)) die ("empty sequence name in %s", filename) ;
+	      isHeader = false ; isSeq = true ;
+	      e.len = e.lineBases = e.lineWidth = 0 ; e.off = pos + (p - buf) ; isShort = false ;
+	    }
+	  else			/* a sequence line */
+	    { U64 nBases = (lineLen && last == '\r') ? lineLen - 1 : lineLen ;
+	      if (!e.lineWidth) { e.lineBases = nBases ; e.lineWidth = lineLen + 1 ; }
+	      else if (isShort && nBases)
+		die ("different line lengths in sequence %s in %s", arrp(name, 0, char), filename) ;
+	      else if (nBases != e.lineBases)
+		{ if (nBases > e.lineBases)
+		    die ("different line lengths in sequence %s in %s", arrp(name, 0, char), filename) ;
+		  isShort = true ;
+		}
+	      e.len += nBases ;
+	    }
+	}
+      pos += n ;
+    }
+  if (isHeader) die ("incomplete header line at end of %s", filename) ;
+  if (!isStart && lineLen)	/* last line without a newline */
+    { if (isShort || (e.lineWidth && lineLen > e.lineBases))
+	die ("different line lengths in sequence %s in %s", arrp(name, 0, char), filename) ;
+      if (!e.lineWidth) { e.lineBases = lineLen ; e.lineWidth = lineLen + 1 ; }
+      e.len += lineLen ;
+    }
+  if (isSeq) faiAdd (sx, name, &e, &nMax) ;
+  arrayDestroy (name) ;
+  free (buf) ;
+  bufClose (&in) ;
+}
+
+static bool faiRead (SeqIndex *sx, char *faiName)
+{
+  FILE *f = fopen (faiName, "r") ;
+  if (!f) return false ;
+  U64 nMax = 1024 ;
+  char *line = 0 ;
+  size_t lineSize = 0 ;
+  sx->fai = new (nMax, FaiEntry) ;
+  while (getline (&line, &lineSize, f) > 0)
+    { char *s = strchr (line, '\t') ;
+      FaiEntry e ;
+      U32 i ;
+      if (!s || sscanf (s+1, "%llu %llu %llu %llu", &e.len, &e.off, &e.lineBases, &e.lineWidth) != 4)
+	die ("bad line in FASTA index %s: %s", faiName, line) ;
+      *s = 0 ;
+      if (!dictAdd (sx->dict, line, &i)) die ("duplicate name %s in FASTA index %s", line, faiName) ;
+      if (i >= nMax) { sx->fai = newResize (sx->fai, nMax, 2*nMax, FaiEntry) ; nMax *= 2 ; }
+      sx->fai[i] = e ;
+    }
+  free (line) ;
+  fclose (f) ;
+  return true ;
+}
+
+static void faiWrite (SeqIndex *sx, char *faiName)
+{
+  FILE *f = fopen (faiName, "w") ;
+  if (!f) { warn ("can't write FASTA index %s - continuing without saving it", faiName) ; return ; }
+  U32 i ;
+  for (i = 0 ; i < dictMax(sx->dict) ; ++i)
+    { FaiEntry *e = &sx->fai[i] ;
+      fprintf (f, "%s\t%llu\t%llu\t%llu\t%llu\n", dictName (sx->dict, i),
+	       e->len, e->off, e->lineBases, e->lineWidth) ;
+    }
+  fclose (f) ;
+}
+
+static bool gziRead (SeqIndex *sx, char *gziName)
+{
+  FILE *f = fopen (gziName, "r") ;
+  if (!f) return false ;
+  U64 n, k ;
+  bool isOK = (fread (&n, sizeof(U64), 1, f) == 1) ;
+  if (isOK)
+    { sx->nBlock = n+1 ;
+      sx->cOff = new (n+2, uint64_t) ; sx->uOff = new (n+2, uint64_t) ;
+      sx->cOff[0] = sx->uOff[0] = 0 ;
+      for (k = 1 ; isOK && k <= n ; ++k)
+	isOK = (fread (&sx->cOff[k], sizeof(U64), 1, f) == 1 && fread (&sx->uOff[k], sizeof(U64), 1, f) == 1
+		&& sx->cOff[k] > sx->cOff[k-1] && sx->cOff[k] < sx->mapSize) ;
+    }
+  fclose (f) ;
+  if (!isOK) die ("bad BGZF index %s", gziName) ;
+  sx->cOff[sx->nBlock] = sx->mapSize ;
+  sx->uOff[sx->nBlock] = sx->uOff[n] + bgzfLe32 (sx->map + sx->mapSize - 4) ;
+  return true ;
+}
+
+static void gziBuild (SeqIndex *sx, char *filename)
+{
+  if (!(sx->cOff = bgzfBlocks (sx->map, sx->mapSize, &sx->nBlock, &sx->uOff)))
+    die ("%s is compressed but not BGZF - recompress it with bgzip for random access", filename) ;
+}
+
+static void gziWrite (SeqIndex *sx, char *gziName)
+{
+  FILE *f = fopen (gziName, "w") ;
+  if (!f) { warn ("can't write BGZF index %s - continuing without saving it", gziName) ; return ; }
+  U64 n = sx->nBlock - 1 ;
+  I64 k ;
+  fwrite (&n, sizeof(U64), 1, f) ;
+  for (k = 1 ; k < sx->nBlock ; ++k)
+    { fwrite (&sx->cOff[k], sizeof(U64), 1, f) ; fwrite (&sx->uOff[k], sizeof(U64), 1, f) ; }
+  fclose (f) ;
+}
+
+static void seqIndexDestroy (SeqIndex *sx)
+{
+  dictDestroy (sx->dict) ;
+  free (sx->fai) ;
+  if (sx->map)
+    { munmap (sx->map, sx->mapSize) ;
+      free (sx->cOff) ; free (sx->uOff) ;
+      inflateEnd (&sx->z) ;
+      free (sx->block) ;
+    }
+  else
+    close (sx->fd) ;
+  free (sx) ;
+}
+
+SeqIO *seqIOopenIndexed (char *filename, int *convert)
+{
+  int fd = open (filename, O_RDONLY) ;
+  if (fd < 0) return 0 ;
+  struct stat st ;
+  U8 magic[2] ;
+  if (fstat (fd, &st) || !S_ISREG(st.st_mode) || read (fd, magic, 2) != 2)
+    { close (fd) ; return 0 ; }
+
+  SeqIndex *sx = new0 (1, SeqIndex) ;
+  sx->dict = dictCreate (1024) ;
+  if (magic[0] == 0x1f && magic[1] == 0x8b)
+    { sx->mapSize = st.st_size ;
+      sx->map = mmap (0, sx->mapSize, PROT_READ, MAP_PRIVATE, fd, 0) ;
+      close (fd) ;
+      if (sx->map == MAP_FAILED) die ("failed to map %s", filename) ;
+      char *gziName = fnameTag (filename, "gzi") ;
+      if (!isIndexCurrent (gziName, &st) || !gziRead (sx, gziName))
+	{ gziBuild (sx, filename) ; gziWrite (sx, gziName) ; }
+      free (gziName) ;
+      if (inflateInit2 (&sx->z, -15) != Z_OK) die ("failed to initialise inflate") ;
+      sx->block = new (65536, char) ;
+      sx->blockNum = -1 ;
+    }
+  else
+    sx->fd = fd ;
+  char *faiName = fnameTag (filename, "fai") ;
+  if (!isIndexCurrent (faiName, &st) || !faiRead (sx, faiName))
+    { faiBuild (sx, filename) ; faiWrite (sx, faiName) ; }
+  free (faiName) ;
+
+  SeqIO *si = new0 (1, SeqIO) ;
+  si->type = FASTA ;
+  si->index = sx ;
+  si->convert = convert ? convert : dna2textAmbigConv ;
+  si->fastaConv = fastaConvCreate (si->convert) ;
+  si->bufSize = 1 << 16 ;
+  si->b = si->buf = new (si->bufSize, char) ;
+  si->nSeq = dictMax(sx->dict) ;
+  U32 i ;
+  for (i = 0 ; i < si->nSeq ; ++i)
+    { si->totSeqLen += sx->fai[i].len ;
+      if (sx->fai[i].len > si->maxSeqLen) si->maxSeqLen = sx->fai[i].len ;
+    }
+  return si ;
+}
+
+static bool bgzfReadRange (SeqIndex *sx, char *s, U64 u0, U64 u1) /* false if past the end */
+{
+  I64 lo = 0, hi = sx->nBlock ;	/* find the block containing u0 */
+  while (hi - lo > 1) { I64 mid = (lo + hi) / 2 ; if (sx->uOff[mid] <= u0) lo = mid ; else hi = mid ; }
+  for ( ; u0 < u1 ; ++lo)
+    { if (lo >= sx->nBlock) return false ;
+      if (lo != sx->blockNum)
+	{ U8 *p = sx->map + sx->cOff[lo] ;
+	  U64 cLen = sx->cOff[lo+1] - sx->cOff[lo] ;
+	  if (bgzfBlockSize (p, cLen) != cLen)
+	    die ("BGZF index does not match blocks at offset %llu", (U64) sx->cOff[lo]) ;
+	  if (bgzfInflate (&sx->z, p, cLen, (U8*) sx->block) != (I64) (sx->uOff[lo+1] - sx->uOff[lo]))
+	    die ("corrupt BGZF block at offset %llu", (U64) sx->cOff[lo]) ;
+	  sx->blockNum = lo ;
+	}
+      U64 k = (u1 < sx->uOff[lo+1] ? u1 : sx->uOff[lo+1]) - u0 ;
+      memcpy (s, sx->block + (u0 - sx->uOff[lo]), k) ;
+      s += k ; u0 += k ;
+    }
+  return true ;
+}
+
+bool seqIOfetch (SeqIO *si, char *name, U64 start, U64 end)
+{
+  SeqIndex *sx = (SeqIndex*) si->index ;
+  U32 i ;
+  if (!sx || !dictFind (sx->dict, name, &i)) return false ;
+  FaiEntry *e = &sx->fai[i] ;
+  if (end > e->len) end = e->len ;
+  if (start > end) return false ;
+
+  U64 b0 = e->off + start, b1 = e->off + end ; /* convert to file offsets via lines */
+  if (e->lineBases)		/* b1 follows base end-1, as base end may be past the file end */
+    { b0 = e->off + (start / e->lineBases) * e->lineWidth + start % e->lineBases ;
+      b1 = (end == start) ? b0
+	: e->off + ((end-1) / e->lineBases) * e->lineWidth + (end-1) % e->lineBases + 1 ;
+    }
+  U64 nameLen = strlen (name), need = nameLen + 1 + (b1 - b0) + 1 ;
+  if (need > si->bufSize)
+    { free (si->buf) ;
+      while (si->bufSize < need) si->bufSize *= 2 ;
+      si->buf = new (si->bufSize, char) ;
+    }
+  si->b = si->buf ;
+  strcpy (si->buf, name) ;
+  si->idStart = 0 ; si->idLen = nameLen ;
+  si->descStart = si->descLen = 0 ;
+  si->seqStart = nameLen + 1 ;
+  char *s = si->buf + si->seqStart ;
+  if (sx->map ? !bgzfReadRange (sx, s, b0, b1)
+      : pread (sx->fd, s, b1 - b0, b0) != (ssize_t)(b1 - b0))
+    return false ;		/* file shorter than its index says */
+  si->seqLen = fastaConvert (si, s, b1 - b0) ;
+  s[si->seqLen] = 0 ;
+  return true ;
+}
+
 void seqIOclose (SeqIO *si)
 { if (si->isWrite)
     { if (si->type <= BINARY)
@@ -165,7 +813,9 @@ void seqIOclose (SeqIO *si)
   free (si->buf) ;
   if (si->seqBuf) free (si->seqBuf) ;
   if (si->qualBuf) free (si->qualBuf) ;
-  if (si->gzf) gzclose (si->gzf) ;
+  if (si->fastaConv) free (si->fastaConv) ;
+  if (si->index) seqIndexDestroy ((SeqIndex*) si->index) ;
+  bufClose (si) ;
   if (si->fd) close (si->fd) ;
 #ifdef ONEIO
   if (si->type == ONE)
@@ -186,7 +836,7 @@ static void bufRefill (SeqIO *si)
   si->idStart -= si->recStart ; si->descStart -= si->recStart ; /* adjust all the offsets */
   si->seqStart -= si->recStart ; si->qualStart -= si->recStart ;
   si->recStart = 0 ;
-  si->nb = gzread (si->gzf, si->b, si->buf + si->bufSize - si->b) ;
+  si->nb = bufRead (si, si->b, si->buf + si->bufSize - si->b) ;
 }
 
 static void bufDouble (SeqIO *si)
@@ -195,7 +845,7 @@ static void bufDouble (SeqIO *si)
   memcpy (newbuf, si->buf, si->bufSize) ;
   si->b = newbuf + si->bufSize ; si->nb = si->bufSize ; /* rely on being at end of old buf */
   free (si->buf) ; si->buf = newbuf ;
-  si->nb = gzread (si->gzf, si->b, si->bufSize) ;
+  si->nb = bufRead (si, si->b, si->bufSize) ;
   si->bufSize *= 2 ;
 }
 
@@ -218,14 +868,12 @@ static void bufHardRefill (SeqIO *si, U64 n) /* like bufRefill() but for bufConf
   si->b -= si->recStart ;		/* will be position after move */
   memmove (si->buf, si->buf + si->recStart, si->b - si->buf) ;
   si->recStart = 0 ; si->b = si->buf ;
-  si->nb += gzread (si->gzf, si->b + si->nb, si->bufSize - si->nb) ;
+  si->nb += bufRead (si, si->b + si->nb, si->bufSize - si->nb) ;
   if (si->nb < n) die ("incomplete sequence record %llu", si->line) ;
 }
 
 #define bufConfirmNbytes(si, n) { if (si->nb < n) bufHardRefill (si, n) ; }
 
-#include <ctype.h>
-
 bool seqIOread (SeqIO *si)
 {
 #ifdef ONEIO
@@ -322,13 +970,24 @@ bool seqIOread (SeqIO *si)
   ++si->line ; bufAdvanceInRecord(si) ;	              /* line 2 */
   si->seqStart = si->b - si->buf ;
   if (si->type == FASTA)
-    { while (si->nb && *si->b != '>')
-	{ while (*si->b != '\n') bufAdvanceInRecord(si) ;
-	  ++si->line ; bufAdvanceEndRecord(si) ;
+    { while (si->nb)		/* find the '>' at the start of the next record, a buffer at a time */
+	{ U64 nLine, k = fastaScan (si->b, si->nb, &nLine) ;
+	  si->line += nLine ;
+	  if (k < si->nb)
+	    { if (si->b + k == sqioSeq(si) || si->b[k-1] == '\n')
+		{ si->b += k ; si->nb -= k ; break ; }
+	      ++k ;		/* a '>' inside a line is left to convert */
+	    }
+	  si->b += k ; si->nb -= k ;
+	  if (!si->nb)
+	    { char last = si->b[-1] ;
+	      if (si->recStart) bufRefill (si) ;
+	      else if (si->b == si->buf + si->bufSize) bufDouble (si) ;
+	      if (!si->nb && last != '\n')
+		{ fprintf (stderr, "incomplete sequence record line %llu\n", si->line) ; return false ; }
+	    }
 	}
-      char *s = sqioSeq(si), *t = s ;
-      while (s < si->b) if ((*t++ = si->convert[(int)*s++]) < 0) --t ;
-      si->seqLen = t - sqioSeq(si) ;
+      si->seqLen = fastaConvert (si, sqioSeq(si), si->b - sqioSeq(si)) ;
     }
   else if (si->type == FASTQ)
     { while (*si->b != '\n') bufAdvanceInRecord(si) ;
@@ -417,18 +1076,19 @@ SeqIO *seqIOopenWrite (char *filename, SeqIOtype type, int* convert, int qualThr
       if (si->fd == -1) { warn ("failed to write to stdout") ; free (si) ; return 0 ; }
     }
   else if (!strcmp (filename, "-z"))
-    { si->gzf = gzdopen (fileno(stdout), "w") ;
-      if (!si->gzf) { warn ("failed to gzdopen stdout", filename) ; free (si) ; return 0 ; }
+    { if (fileno (stdout) == -1) { warn ("failed to write to stdout") ; free (si) ; return 0 ; }
+      si->deflater = deflaterOpen (fileno (stdout)) ;
     }
   else if (isGzip)
-    { si->gzf = gzopen (filename, "w") ;
-      if (!si->gzf) { warn ("failed to gzopen %s", filename) ; free (si) ; return 0 ; }
+    { int fd = open (filename, O_CREAT | O_TRUNC | O_WRONLY, 00644) ;
+      if (fd == -1) { warn ("failed to open %s", filename) ; free (si) ; return 0 ; }
+      si->deflater = deflaterOpen (fd) ;
     }
   else
     { si->fd = open (filename, O_CREAT | O_TRUNC | O_WRONLY, 00644) ;
       if (si->fd == -1) { warn ("failed to open %s", filename) ; free (si) ; return 0 ; }
     }
-  if (si->type == BINARY && si->gzf)
+  if (si->type == BINARY && si->deflater)
     { fprintf (stderr, "can't write a gzipped binary file\n") ; seqIOclose (si) ; return 0 ; }
   
   si->nb = si->bufSize = 1<<24 ;
@@ -469,7 +1129,7 @@ void seqIOflush (SeqIO *si)	/* writes buffer to file and resets to 0 */
 {
   if (!si->isWrite) return ;
   U64 retVal, nBytes = si->b - si->buf ;
-  if (si->gzf) retVal = gzwrite (si->gzf, si->buf, nBytes) ;
+  if (si->deflater) { deflaterWrite ((Deflater*) si->deflater, si->buf, nBytes) ; retVal = nBytes ; }
   else retVal = write (si->fd, si->buf, nBytes) ;
   if (retVal != nBytes) die ("seqio write error %llu not %llu bytes written", retVal, nBytes) ;
   si->b = si->buf ;
@@ -633,17 +1293,6 @@ SeqPack *seqPackCreate (char unpackA)
   return sp ;
 }
 
-static U8 pack[] = {    // sends N (indeed any non-CGT) to A, except 0,1,2,3 are maintained
-   0, 1, 2, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 
-   0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 
-   0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 
-   0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 
-   0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0,
-   0, 0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-   0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0,
-   0, 0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
-} ;
-
 static U8 packC[] = {   // same but send to the complement
    3, 2, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 
    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 
@@ -658,19 +1307,8 @@ static U8 packC[] = {   // same but send to the complement
 U8* seqPack (SeqPack *sp, char *s, U8 *u, U64 len) /* compress s into (len+3)/4 u */
 {
   if (!u) u = new((len+3)/4,U8) ;
-  U8 *u0 = u ;
-  while (len >= 4)
-    { *u++ = pack[(int)s[0]] | (pack[(int)s[1]] << 2) |
-	(pack[(int)s[2]] << 4) | (pack[(int)s[3]] << 6) ;
-      len -= 4 ; s += 4 ;
-    }
-  switch (len)
-    { case 3: *u++ = pack[(int)s[0]] | (pack[(int)s[1]] << 2) |	(pack[(int)s[2]] << 4) ; break ;
-      case 2: *u++ = pack[(int)s[0]] | (pack[(int)s[1]] << 2) ; break ;
-      case 1: *u++ = pack[(int)s[0]] ; break ;
-      case 0: break ;
-    }
-  return u0 ;
+  dnaPack2bit (s, u, len) ; // sends N (indeed any non-CGT) to A, except 0,1,2,3 are maintained
+  return u ;
 }
 
 U8* seqPackRevComp (SeqPack *sp, char *s, U8 *u, U64 len) /* packs the RC of the sequence s */
@@ -703,19 +1341,7 @@ char* seqUnpack (SeqPack *sp, U8 *u, char *s, U64 i, U64 len)
       while ((i++ < 4) && len) { *s++ = sp->unconv[uu & 3] ; uu >>= 2 ; len-- ; }
       ++u ;
     }
-  if (len)
-    { while (len >= 4)
-	{ *(U32*)s = sp->byteExpand[*u] ;
-	  ++u ; s += 4 ; len -= 4 ;
-	}
-      switch (len) // note fall through
-	{
-	case 3: s[2] = sp->unconv[(*u >> 4) & 3] ;
-	case 2: s[1] = sp->unconv[(*u >> 2) & 3] ;
-	case 1: s[0] = sp->unconv[*u & 3] ; 
-	case 0: break ;
-	}
-    }
+  if (len) dnaUnpack2bit (u, s, len, sp->unconv) ;
   return s0 ;
 }
 
@@ -825,7 +1451,7 @@ U64 seqMatchPacked (U8 *a, U64 ia, U8 *b, U64 ib, U64 len)
   a = (U8*) ua ; b = (U8*) ub ;
   seqUnpack (sp, a, sa, ia, l) ; seqUnpack (sp, b, sb, ib, l) ;
   U64 d2 = seqMatchPacked2 (a, ia, b, ib, len) ;
-  char ca, cb ; if (d2) { seqUnpack (sp, a, &ca, d2-1, 1) ; seqUnpack (sp, b, &cb, d2-1, 1) ; }
+  char ca[2], cb[2] ; if (d2) { seqUnpack (sp, a, ca, d2-1, 1) ; seqUnpack (sp, b, cb, d2-1, 1) ; }
 
   U64 uua = 0, uub = 0, d = 0 ; // distance of match
   if (len > 32) // can work in 64-bit words
@@ -870,7 +1496,7 @@ U64 seqMatchPacked (U8 *a, U64 ia, U8 *b, U64 ib, U64 len)
     }
   if (d2)
     printf ("SEQMATCH ia %d ib %d len %d d %lld d2 %lld abuf %s bbuf %s i %d ca %c cb %c\n",
-	    iia, iib, ilen, d, d2, abuf, bbuf, i, ca, cb) ;
+	    iia, iib, ilen, d, d2, abuf, bbuf, i, *ca, *cb) ;
   d = 0 ; // if we get here then they all match
 
  end:
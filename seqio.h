@@ -73,8 +73,12 @@ typedef struct {
   U64   line, recStart ;	/* recStart is the offset for the current record */
   int   fd ;			/* file descriptor, if gzf is not set */
   gzFile gzf ;
+  void *inflater ;		/* threaded gzip/BGZF reader, used instead of gzf if set */
+  void *deflater ;		/* threaded BGZF writer for .gz output */
   char *buf, *b ;		/* b is current pointer in buf */
   int  *convert ;
+  void *fastaConv ;		/* SIMD lookup tables for convert on FASTA input, if usable */
+  void *index ;			/* for seqIOfetch() */
   char *seqBuf, *qualBuf ;	/* used in modes BINARY, VGP, BAM */
   void *handle;			/* used for ONEseq, BAM */
   SeqPack  *seqPack ;
@@ -93,6 +97,18 @@ bool    seqIOread (SeqIO *si) ;
 #define sqioSeq(si)  ((si)->type >= BINARY ? (si)->seqBuf : (si)->buf+(si)->seqStart)
 #define sqioQual(si) ((si)->type >= BINARY ? (si)->qualBuf : (si)->buf+(si)->qualStart)
 
+/* Random access to FASTA files, plain or BGZF compressed as by bgzip.  Uses samtools style
+   filename.fai and, if BGZF, filename.gzi indexes, which are made if missing or out of date.
+   seqIOfetch() puts bases [start,end) (0-based, end clipped to the length) of the named
+   sequence in sqioSeq(si), converted and 0 terminated, and the name in sqioId(si).
+   It returns false if the name is unknown, start is beyond the end, or the file is shorter
+   than its index says, e.g. because the index is out of date.  nSeq, totSeqLen
+   and maxSeqLen are set for the whole file by seqIOopenIndexed().  Don't use seqIOread().
+*/
+
+SeqIO  *seqIOopenIndexed (char *filename, int* convert) ;
+bool    seqIOfetch (SeqIO *si, char *name, U64 start, U64 end) ;
+
 void    seqIOreferenceFileName (char *refFileName) ; /* resets this (globally) for CRAM */
 
 SeqIO  *seqIOopenWrite (char *filename, SeqIOtype type, int* convert, int qualThresh) ;
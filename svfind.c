@@ -213,10 +213,32 @@ int main (int argc, char *argv[])
   Overlap *olaps = new (nOverlaps, Overlap) ;
   oneGoto(ofIn, 'A', 1) ; // go to the start of alignment
   oneReadLine(ofIn) ;
-  for (i = 0 ; i < nOverlaps ; ++i)
-    { Read_Aln_Overlap (ofIn, olaps+i) ;
-      Skip_Aln_Trace (ofIn) ;
-    }
+  { // read the overlaps in blocks as columns - the traces are skipped, we only need lengths
+#define BATCH 65536
+    I64 k, n, *c = new (11*BATCH, I64) ;
+    OneColumn col[11] = { {'A',0,c}, {'A',1,c+BATCH}, {'A',2,c+2*BATCH}, {'A',3,c+3*BATCH},
+			  {'A',4,c+4*BATCH}, {'A',5,c+5*BATCH}, {'R',-1,c+6*BATCH},
+			  {'D',0,c+7*BATCH}, {'T',-1,c+8*BATCH}, {'T',0,c+9*BATCH}, {'X',0,c+10*BATCH} } ;
+    for (i = 0 ; i < nOverlaps ; i += n)
+      { n = oneReadBatch (ofIn, 'A', BATCH, 11, col) ;
+	if (!n) die ("only read %d of %lld overlaps from %s", i, nOverlaps, *argv) ;
+	for (k = 0 ; k < n ; ++k)
+	  { Overlap *o = olaps + i + k ;
+	    if (!c[8*BATCH+k]) die ("failed to find trace record in .1aln object %lld", i+k+1) ;
+	    if (c[9*BATCH+k] != c[10*BATCH+k])
+	      die ("X-line and T-lines should have the same length, object %lld", i+k+1) ;
+	    o->aread = c[k] ;
+	    o->path.abpos = c[BATCH+k] ;
+	    o->path.aepos = c[2*BATCH+k] ;
+	    o->bread = c[3*BATCH+k] ;
+	    o->path.bbpos = c[4*BATCH+k] ;
+	    o->path.bepos = c[5*BATCH+k] ;
+	    o->flags = c[6*BATCH+k] ? COMP_FLAG : 0 ;
+	    o->path.diffs = c[7*BATCH+k] ;
+	  }
+      }
+    free (c) ;
+  }
   printf ("read %d overlaps\n", (int) nOverlaps) ;
   oneFileClose (ofIn) ;
 
@@ -58,6 +58,7 @@ int main (int argc, char *argv[])
   if (!outIO) die ("failed to open %s to write as a sequence file", outFileName) ;
 
   // now read the .1aln file
+  oneSkipList (ofIn, 'T', true) ; oneSkipList (ofIn, 'X', true) ; // don't need the traces
   I64 nAlign = 0 ;
   oneStats (ofIn, 'A', &nAlign, 0, 0) ;
   Array at = arrayCreate (nAlign, TanLine) ;
@@ -13,40 +13,61 @@
 
 #include "alntools.h"
 
+typedef struct { Gdb *gdb ; TanLine *tl ; } ScanData ;
+
+static void *scanAlign (OneFile *of, I64 iStart, I64 iEnd, void *arg)
+{
+  ScanData *sd = (ScanData*) arg ;
+  Gdb *gdb = sd->gdb ;
+  while (of->lineType == 'A' && oneObject(of,'A') < iEnd)
+    { TanLine *b = sd->tl + oneObject(of,'A') - 1 ;
+      int ctg = oneInt(of,0) ;
+      if (ctg != oneInt(of,3))
+	die ("target mismatch line %lld - not a TAN file?", (long long)of->line) ;
+      b->seq     = ctg2seq(gdb,ctg) ;
+      b->start   = ctg2pos(gdb,ctg,oneInt(of,4)) ;
+      b->end     = ctg2pos(gdb,ctg,oneInt(of,2)) ;
+      double len = oneInt(of,2) - oneInt(of,4) ;
+      while (oneReadLine(of) && of->lineType != 'A')
+	if (of->lineType == 'D') b->score = (int)(1000*(1.0 - oneInt(of,0)/len)) ;
+	else if (of->lineType == 'U') b->unit = oneInt(of,0) ;
+    }
+  return 0 ;
+}
+
 int main (int argc, char *argv[])
 {
+  int nThreads = 1 ;
+  
   storeCommandLine (argc, argv) ;
   --argc ; ++argv ;
-  if (argc != 1) die ("Usage: tanbed <.1aln file>") ;
+  if (argc == 3 && !strcmp (*argv, "-T"))
+    { nThreads = atoi (argv[1]) ; argc -= 2 ; argv += 2 ;
+      if (nThreads < 1) die ("number of threads %d must be at least 1", nThreads) ;
+    }
+  if (argc != 1) die ("Usage: tanbed [-T <threads>] <.1aln file>") ;
 
   OneSchema *schema = oneSchemaCreateFromText (schemaText) ;
-  OneFile *of = oneFileOpenRead (*argv, schema, "aln", 1) ;
+  OneFile *of = oneFileOpenRead (*argv, schema, "aln", nThreads) ;
   if (!of) die ("failed to open .1aln file %s", *argv) ;
+  oneSkipList (of, 'T', true) ; oneSkipList (of, 'X', true) ; // don't need the traces
   Gdb *gdb = readGdb (of, 1, stderr) ;
   if (of->lineType != 'A') die ("unexpected line type %c", of->lineType) ;
 
   I64 nAlign = 0 ;
   oneStats (of, 'A', &nAlign, 0, 0) ;
   Array ab = arrayCreate (nAlign, TanLine) ;
-  I64 totAlign = 0 ;
-  while (of->lineType == 'A')
-    { TanLine *b = arrayp(ab, arrayMax(ab), TanLine) ;
-      int ctg = oneInt(of,0) ;
-      if (ctg != oneInt(of,3))
-	die ("target mismatch line %lld - not a TAN file?", (long long)of->line) ;
-      b->seq     = ctg2seq(gdb,ctg) ;
-      b->start   = ctg2pos(gdb,ctg,oneInt(of,4)) ;
-      b->end     = ctg2pos(gdb,ctg,oneInt(of,2)) ;
-      double len = oneInt(of,2) - oneInt(of,4) ;
-      totAlign  += oneInt(of,2) - oneInt(of,4) ;
-      while (oneReadLine(of) && of->lineType != 'A')
-	if (of->lineType == 'D') b->score = (int)(1000*(1.0 - oneInt(of,0)/len)) ;
-	else if (of->lineType == 'U') b->unit = oneInt(of,0) ;
-    }
+  arrayMax(ab) = nAlign ; // each scan thread fills its own part of the array
+  ScanData sd = { gdb, arrp(ab, 0, TanLine) } ;
+  void **results = oneParallelScan (of, 'A', scanAlign, &sd) ;
+  if (!results) die ("failed to scan %s: %s", *argv, oneErrorString()) ;
+  free (results) ;
+  I64 i, totAlign = 0 ;
+  for (i = 0 ; i < nAlign ; ++i)
+    { TanLine *b = arrp(ab, i, TanLine) ; totAlign += b->end - b->start ; }
   oneFileClose (of) ;
   arraySort (ab, tanLineCompareSeq) ;
 
-  int i ;
   for (i = 0 ; i < arrayMax(ab) ; ++i)
     { TanLine *b = arrp(ab, i, TanLine) ;
       printf ("%s\t", dictName(gdb->seqDict, b->seq)) ;